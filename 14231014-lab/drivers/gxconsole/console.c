@@ -37,3 +37,9 @@ void printstr(char *s)
 		printcharc(*s++);
 }
 
+
+/*  Returns 0 if no character is waiting.  */
+char scancharc(void)
+{
+	return *((volatile unsigned char *) PUTCHAR_ADDRESS);
+}
@@ -40,4 +40,9 @@
 #define STATUSF_IP4 0x1000
 #define STATUS_CU0 0x10000000
 #define	STATUS_KUC 0x2
+#define	STATUS_IEP 0x4
+#define	STATUS_KUP 0x8
+
+/* Status of a user env: user mode, interrupts on after rfe, no CP0 */
+#define STATUS_USER (STATUSF_IP4 | STATUS_KUP | STATUS_IEP)
 #endif
@@ -0,0 +1,62 @@
+/* Batched syscalls through a page shared by an env and the kernel.
+ *
+ * sys_batch_setup() maps a zeroed struct Batch at a va of the env's
+ * choice.  The env queues syscalls in b_ent[] by filling entries and
+ * advancing b_tail, then makes one sys_batch_enter() for all of them.
+ * The kernel runs the entries from b_head to b_tail in order, stores
+ * each one's return value in be_ret and advances b_head past it.
+ *
+ * Only syscalls that run on the fast path (see include/syscall.h) can
+ * be batched; the others, and batch syscalls themselves, complete
+ * with -E_INVAL. */
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "types.h"
+
+#define BATCH_NENT	64		/* power of two */
+
+struct Batch_ent {
+	u_int be_sysno;
+	u_int be_arg[5];		/* a1..a5 of msyscall() */
+	int be_ret;			/* set by the kernel */
+	u_int be_pad;
+};
+
+struct Batch {
+	volatile u_int b_head;		/* entries completed, ever */
+	volatile u_int b_tail;		/* entries queued, ever */
+	u_int b_pad[2];
+	struct Batch_ent b_ent[BATCH_NENT];
+};
+
+/* Overview:
+ *	Queue syscall `sysno` with arguments a1..a5 on `b`.
+ *
+ * Post-Condition:
+ *	Return the entry, whose be_ret is valid once b_head has passed it,
+ *	or 0 if all BATCH_NENT entries are pending.
+ */
+static inline struct Batch_ent *
+batch_queue(struct Batch *b, u_int sysno, u_int a1, u_int a2, u_int a3,
+			u_int a4, u_int a5)
+{
+	struct Batch_ent *be;
+
+	if (b->b_tail - b->b_head >= BATCH_NENT) {
+		return 0;
+	}
+
+	be = &b->b_ent[b->b_tail & (BATCH_NENT - 1)];
+	be->be_sysno = sysno;
+	be->be_arg[0] = a1;
+	be->be_arg[1] = a2;
+	be->be_arg[2] = a3;
+	be->be_arg[3] = a4;
+	be->be_arg[4] = a5;
+	b->b_tail++;
+	return be;
+}
+
+#endif /* _BATCH_H_ */
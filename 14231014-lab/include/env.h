@@ -10,22 +10,67 @@
 
 #define LOG2NENV	10
 #define NENV		(1<<LOG2NENV)
-#define ENVX(envid)	((envid) & (NENV - 1))
-#define GET_ENV_INDEX(envid) (((envid)>> 11)<<6)
+#define ENVX(envid)	((envid) & (NENV - 1))
+
+// An envid is a generation count above the slot index.  The generation
+// goes up each time the slot is reused, so stale envids fail envid2env;
+// it never reaches bit 31 and is never 0, so envids stay positive and
+// nonzero.
+#define ENV_GEN(envid)	((envid) >> LOG2NENV)
+#define ENV_GEN_MASK	((1 << (31 - LOG2NENV)) - 1)
+
+// EntryHi ASID field.  The R3000 has NASID ASIDs, handed out by slot,
+// so slots NASID apart share one: env_run flushes an ASID's entries
+// whenever the env it switches to was not the last to run under it.
+#define NASID		64
+#define ENV_ASID(envid)	((ENVX(envid) & (NASID - 1)) << 6)
 
 // Values of env_status in struct Env
 #define ENV_FREE	0
 #define ENV_RUNNABLE		1
 #define ENV_NOT_RUNNABLE	2
+#define ENV_TEMPLATE		3	// frozen by env_snapshot, only cloned
+
+// sys_ipc_send_pages: most pages per call, and the perm bit asking for
+// the pages to be moved rather than shared
+#define IPC_MAXPAGE	64
+#define IPC_MOVE	0x0002
+
+// PT_LOAD segments remembered for a lazily loaded env (env_create_lazy)
+#define ENV_NSEG	4
 
+struct Env_seg {
+	u_long es_va;			// segment start
+	u_long es_memsz;		// bytes in memory, including bss
+	u_char *es_bin;			// file bytes, in the kernel image
+	u_long es_filesz;		// bytes backed by es_bin
+	u_int es_flags;			// PF_R/PF_W/PF_X
+};
+
+// The fields the scheduler and the fault paths look at on every pass
+// over `envs`, packed into one 64-byte, 64-byte aligned entry so a scan
+// does not drag trapframes through the cache.  Everything else lives in
+// the parallel env_colds array, see env_cold().
 struct Env {
-	struct Trapframe env_tf;        // Saved registers
 	LIST_ENTRY(Env) env_link;       // Free list
 	u_int env_id;                   // Unique environment identifier
 	u_int env_parent_id;            // env_id of this env's parent
 	u_int env_status;               // Status of the environment
-	Pde  *env_pgdir;                // Kernel virtual address of page dir
+	Pde  *env_pgdir;                // Kernel virtual address of page dir
 	u_int env_cr3;
+	u_int env_asid;			// ENV_ASID(env_id), for EntryHi
+
+	// Lab 6 scheduler counts
+	u_int env_runs;			// number of times been env_run'ed
+
+	// page fault counts
+	u_int env_pgfaults;		// TLB misses that had to map a page
+	u_int env_prefaulted;		// neighbours mapped ahead by pageout();
+					// only those touched later save a fault
+} __attribute__((aligned(64)));
+
+struct Env_cold {
+	struct Trapframe env_tf;        // Saved registers
 
 	// Lab 4 IPC
 	u_int env_ipc_value;            // data value sent to us 
@@ -33,30 +78,89 @@ struct Env {
 	u_int env_ipc_recving;          // env is blocked receiving
 	u_int env_ipc_dstva;		// va at which to map received page
 	u_int env_ipc_perm;		// perm of page mapping received
+	u_int env_ipc_npage;		// pages the window at env_ipc_dstva
+					// takes, then pages received
+	u_int env_ring_wait;		// va of the ring blocked on in
+					// sys_ring_wait, or 0
 
 	// Lab 4 fault handling
 	u_int env_pgfault_handler;      // page fault state
 	u_int env_xstacktop;            // top of exception stack
 
-	// Lab 6 scheduler counts
-	u_int env_runs;			// number of times been env_run'ed
-};
-
+	// batched syscalls: KVA of the env's struct Batch page, which holds
+	// a reference for as long as this points at it, or 0
+	u_int env_batch;
+
+	// KVA of the env's struct Uinfo page, mapped read-only at UINFO;
+	// holds a reference, like env_batch
+	u_int env_info;
+
+	// lazy loading: segments whose pages pageout() brings in
+	u_int env_nseg;
+	struct Env_seg env_seg[ENV_NSEG];
+};
+
 LIST_HEAD(Env_list, Env);
 extern struct Env *envs;		// All environments
 extern struct Env *curenv;	        // the current env
+extern struct Env_cold *env_colds;	// envs[i]'s cold half is env_colds[i]
+
+// envs is mapped read-only for user space at UENVS; env_colds, which
+// holds saved registers and kernel pointers, is not mapped there at all.
+
+static inline struct Env_cold *
+env_cold(struct Env *e)
+{
+	return &env_colds[e - envs];
+}
 
 void env_init(void);
 int env_alloc(struct Env **e, u_int parent_id);
 void env_free(struct Env *);
 void env_create(u_char *binary, int size);
+void env_create_lazy(u_char *binary, int size);
+int env_lazy_fault(struct Env *e, u_long va, int share_only);
+int env_lazy_covers(struct Env *e, u_long va);
 void env_destroy(struct Env *e);
+int env_snapshot(struct Env *e);
+int env_clone(struct Env *tmpl, struct Env **new);
 
 int envid2env(u_int envid, struct Env **penv, int checkperm);
+struct Env *pgdir2env(Pde *pgdir);
+void env_save(void);
 void env_run(struct Env *e);
 
+// pages placed by load_icode: mapped straight from the kernel image,
+// or allocated and copied; for lazily loaded envs, pages brought in
+// on fault and pages still untouched when the env was freed
+struct Icode_stat {
+	u_long shared;
+	u_long copied;
+	u_long lazy;
+	u_long untouched;
+};
+extern struct Icode_stat icode_stat;
+
+// page directories kept by env_free for reuse (pgdir_pool in env.c):
+// at most pgdir_pool_max, PGDIR_POOL_MAX by default; 0 turns it off
+#define PGDIR_POOL_MAX		32
+#define PGDIR_POOL_PREBUILT	4	// built by env_init
+
+struct Pgdir_pool_stat {
+	u_long hits;		// env_setup_vm served from the pool
+	u_long misses;		// pool empty, built a new one
+	u_long recycled;	// returned to the pool by env_free
+	u_long released;	// pool full, given back to the page allocator
+};
+extern struct Pgdir_pool_stat pgdir_pool_stat;
+extern u_int pgdir_pool_max;
+
 
 // for the grading script
+//
+// Embedded binaries should be page aligned in the kernel image (e.g.
+// emitted with __attribute__((aligned(BY2PG)))): then load_icode maps
+// their read-only pages straight into the env instead of copying them.
 #define ENV_CREATE2(x, y) \
 { \
 	extern u_char x[], y[]; \
@@ -71,4 +175,12 @@ void env_run(struct Env *e);
 		(u_int)binary_##x##_size); \
 }
 
+#define ENV_CREATE_LAZY(x) \
+{ \
+	extern u_char binary_##x##_start[];\
+	extern u_int binary_##x##_size; \
+	env_create_lazy(binary_##x##_start, \
+		(u_int)binary_##x##_size); \
+}
+
 #endif // !_ENV_H_
@@ -0,0 +1,69 @@
+/* The initrd is one archive of user programs linked into the kernel
+ * (init/initrd.S), built by tools/mkinitrd.  This header is shared by
+ * both, so it only uses plain C types.
+ *
+ * Layout, all words in target (little-endian) byte order:
+ *
+ *	struct Initrd_hdr
+ *	unsigned int bucket[ih_nbucket]	first entry of each hash chain
+ *	struct Initrd_ent ent[ih_nent]
+ *	entry data, each starting on a page boundary
+ *
+ * An entry with INITRD_Z set holds LZSS data (see initrd_inflate) that
+ * the kernel inflates the first time the program is looked up. */
+
+#ifndef _INITRD_H_
+#define _INITRD_H_
+
+#define INITRD_MAGIC	0x44525449	/* "ITRD" */
+#define INITRD_NAMELEN	32		/* including the NUL */
+#define INITRD_MAXENT	128
+#define INITRD_ALIGN	4096		/* entry data alignment, BY2PG */
+#define INITRD_NIL	0xffffffff	/* end of a hash chain */
+
+// ie_flags
+#define INITRD_Z	1		/* data is LZSS compressed */
+
+// LZSS: 4K window, matches of 3..18 bytes
+#define INITRD_LZ_WINDOW	4096
+#define INITRD_LZ_MIN		3
+#define INITRD_LZ_MAX		18
+
+struct Initrd_hdr {
+	unsigned int ih_magic;
+	unsigned int ih_nent;
+	unsigned int ih_nbucket;	/* power of two */
+	unsigned int ih_size;		/* whole archive, in bytes */
+};
+
+struct Initrd_ent {
+	char ie_name[INITRD_NAMELEN];
+	unsigned int ie_hash;		/* initrd_hash(ie_name) */
+	unsigned int ie_next;		/* next entry in the chain, or INITRD_NIL */
+	unsigned int ie_off;		/* data offset from the archive start */
+	unsigned int ie_size;		/* bytes stored */
+	unsigned int ie_rawsize;	/* bytes once inflated */
+	unsigned int ie_flags;
+};
+
+/* FNV-1a; bucket = hash & (ih_nbucket - 1) */
+static inline unsigned int
+initrd_hash(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	while (*s) {
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	}
+
+	return h;
+}
+
+#ifndef INITRD_HOST
+unsigned int initrd_cache_size(void);
+void initrd_init(void *cache);
+int initrd_lookup(const char *name, unsigned char **binary, unsigned int *size);
+int initrd_spawn(const char *name, int lazy);
+#endif
+
+#endif /* _INITRD_H_ */
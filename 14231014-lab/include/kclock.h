@@ -3,7 +3,16 @@
 #ifndef _KCLOCK_H_
 #define _KCLOCK_H_
 #define	IO_RTC		0xb5000100		/* RTC port */
+#define	IO_RTC_READ	0xb5000000		/* latch the wall clock */
+#define	IO_RTC_SEC	0xb5000010		/* ... then read it */
+#define	IO_RTC_USEC	0xb5000020
+#define	KCLOCK_HZ	200			/* clock ticks per second */
 #ifndef __ASSEMBLER__
+#include <types.h>
+
+extern u_int kclock_ticks;		/* ticks since kclock_init() */
+
 void kclock_init(void);
+u_int kclock_usec(void);
 #endif /* !__ASSEMBLER__ */
 #endif
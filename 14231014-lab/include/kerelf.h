@@ -0,0 +1,73 @@
+/* This is a simplified ELF header for the kernel's loader: only the
+ * 32-bit structures and the constants it actually looks at. */
+
+#ifndef _KER_ELF_H_
+#define _KER_ELF_H_
+
+#include "types.h"
+
+typedef u_int32_t Elf32_Addr;
+typedef u_int32_t Elf32_Off;
+typedef u_int16_t Elf32_Half;
+typedef u_int32_t Elf32_Word;
+
+#define EI_NIDENT	16
+
+typedef struct {
+	unsigned char	e_ident[EI_NIDENT];	/* Magic number and other info */
+	Elf32_Half	e_type;			/* Object file type */
+	Elf32_Half	e_machine;		/* Architecture */
+	Elf32_Word	e_version;		/* Object file version */
+	Elf32_Addr	e_entry;		/* Entry point virtual address */
+	Elf32_Off	e_phoff;		/* Program header table file offset */
+	Elf32_Off	e_shoff;		/* Section header table file offset */
+	Elf32_Word	e_flags;		/* Processor-specific flags */
+	Elf32_Half	e_ehsize;		/* ELF header size in bytes */
+	Elf32_Half	e_phentsize;		/* Program header table entry size */
+	Elf32_Half	e_phnum;		/* Program header table entry count */
+	Elf32_Half	e_shentsize;		/* Section header table entry size */
+	Elf32_Half	e_shnum;		/* Section header table entry count */
+	Elf32_Half	e_shstrndx;		/* Section header string table index */
+} Elf32_Ehdr;
+
+#define EI_MAG0		0
+#define ELFMAG0		0x7f
+#define EI_MAG1		1
+#define ELFMAG1		'E'
+#define EI_MAG2		2
+#define ELFMAG2		'L'
+#define EI_MAG3		3
+#define ELFMAG3		'F'
+
+typedef struct {
+	Elf32_Word	p_type;			/* Segment type */
+	Elf32_Off	p_offset;		/* Segment file offset */
+	Elf32_Addr	p_vaddr;		/* Segment virtual address */
+	Elf32_Addr	p_paddr;		/* Segment physical address */
+	Elf32_Word	p_filesz;		/* Segment size in file */
+	Elf32_Word	p_memsz;		/* Segment size in memory */
+	Elf32_Word	p_flags;		/* Segment flags */
+	Elf32_Word	p_align;		/* Segment alignment */
+} Elf32_Phdr;
+
+/* Legal values for p_type (segment type).  */
+#define PT_NULL		0		/* Program header table entry unused */
+#define PT_LOAD		1		/* Loadable program segment */
+
+/* Legal values for p_flags (segment flags).  */
+#define PF_X		(1 << 0)	/* Segment is executable */
+#define PF_W		(1 << 1)	/* Segment is writable */
+#define PF_R		(1 << 2)	/* Segment is readable */
+
+/* Called by load_elf() once per PT_LOAD segment: `bin` points at the
+ * segment's `bin_size` bytes inside the image, to be placed at `va` in
+ * a region of `sgsize` bytes (the tail beyond bin_size is bss). */
+typedef int (*elf_mapper_t)(u_long va, u_int32_t sgsize, u_char *bin,
+			    u_int32_t bin_size, u_int32_t flags,
+			    void *user_data);
+
+int is_elf_format(u_char *binary);
+int load_elf(u_char *binary, int size, u_long *entry_point, void *user_data,
+	     elf_mapper_t map);
+
+#endif /* _KER_ELF_H_ */
@@ -1,7 +1,9 @@
 #ifndef _MMU_H_
 #define _MMU_H_
 
+#ifndef __ASSEMBLER__
 #include "types.h"
+#endif
 /*
  * This file contains:
  *
@@ -35,6 +37,10 @@
 #define PTE_R		0x0400	// Dirty bit ,'0' means only read ,otherwise make interrupt
 #define PTE_UC		0x0800	// unCached
 
+// software bits, ignored by the hardware
+#define PTE_COW		0x0001	// Copy On Write: write faults get a private copy
+#define PTE_SHARED	0x0004	// stays shared: never moved by IPC or made copy-on-write
+
 /*
  * Part 2.  Our conventions.
  */
@@ -65,8 +71,8 @@
  o  UTOP,UENVS   -----> +----------------------------+------------0x7f40 0000    |
  o  UXSTACKTOP -/       |     user exception stack   |     BY2PG                 |
  o                      +----------------------------+------------0x7f3f f000    |
- o                      |       Invalid memory       |     BY2PG                 |
- o      USTACKTOP ----> +----------------------------+------------0x7f3f e000    |
+ o                      |  info page, read-only      |     BY2PG                 |
+ o  USTACKTOP,UINFO --> +----------------------------+------------0x7f3f e000    |
  o                      |     normal user stack      |     BY2PG                 |
  o                      +----------------------------+------------0x7f3f d000    |
  a                      |                            |                           |
@@ -90,13 +96,15 @@
 #define ULIM 0x80000000
 
 #define UVPT (ULIM - PDMAP)
+#define UXRET (UVPT - BY2PG)	// page fault return stub, in the UPAGES window
 #define UPAGES (UVPT - PDMAP)
 #define UENVS (UPAGES - PDMAP)
 
 #define UTOP UENVS
-#define UXSTACKTOP (0x82000000)
+#define UXSTACKTOP (UTOP)
 
 #define USTACKTOP (UTOP - 2*BY2PG)
+#define UINFO USTACKTOP		// struct Uinfo, see include/uinfo.h
 #define UTEXT 0x00400000
 
 
@@ -105,8 +113,16 @@
  * Part 3.  Our helper functions.
  */
 
+#ifndef __ASSEMBLER__
+
 void bcopy(const void *, void *, size_t);
 void bzero(void *, size_t);
+void *memcpy(void *, const void *, size_t);
+void *memset(void *, int, size_t);
+
+// whole-page variants; both addresses must be page aligned
+void bcopy_page(const void *, void *);
+void bzero_page(void *);
 
 extern char bootstacktop[], bootstack[];
 
@@ -136,4 +152,6 @@ typedef u_long Pte;
 #define assert(x)	\
 	do {	if (!(x)) panic("assertion failed: %s", #x); } while (0)
 
+#endif /* !__ASSEMBLER__ */
+
 #endif // !_MMU_H_
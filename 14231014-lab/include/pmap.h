@@ -10,6 +10,14 @@
 LIST_HEAD(Page_list, Page);
 typedef LIST_ENTRY(Page) Page_LIST_entry_t;
 
+// One (page directory, va) mapping of a physical page, for the
+// reverse-mapping chain of pages mapped more than once.
+struct Rmap {
+	Pde *rm_pgdir;
+	u_long rm_va;
+	struct Rmap *rm_next;
+};
+
 struct Page {
 	Page_LIST_entry_t pp_link;	/* free list link */
 
@@ -19,15 +27,82 @@ struct Page {
 	// do not have valid reference count fields.
 
 	u_short pp_ref;
+
+	// For a page used as a second-level page table: how many of its
+	// entries are valid.  For a page directory: how many page tables
+	// it points to.  Unused for other pages.
+	u_short pp_live;
+
+	// For a page directory: the EntryHi ASID of the env it belongs to,
+	// which tlb_invalidate() flushes its entries under.
+	u_short pp_asid;
+
+	// Reverse mapping: the first page_insert() mapping of this page is
+	// kept inline in pp_rpgdir/pp_rva (pp_rpgdir == 0 if unmapped), any
+	// others hang off pp_rmap.
+	Pde *pp_rpgdir;
+	u_long pp_rva;
+	struct Rmap *pp_rmap;
 };
 
 extern struct Page *pages;
+
+/* The R3000's caches are direct mapped and physically indexed, 64KB each
+ * under GXemul, so a physical page can land in one of 16 page-sized
+ * slots ("colors").  Free pages are kept per color. */
+#define PAGE_NCOLOR	16
+#define VA2COLOR(va)	(VPN(va) & (PAGE_NCOLOR - 1))
+
+struct Page_color_stat {
+	u_long exact;		/* allocations served in the wanted color */
+	u_long stolen;		/* allocations served from a neighbouring color */
+};
+
+extern struct Page_color_stat page_color_stat;
+
+/* Default fault-around window of pageout(), in pages.  Must be a power
+ * of two no larger than a page table (1024). */
+#define FAULT_AROUND_PAGES	8
+
+extern u_int fault_around_pages;
+
+/* Pages on the free lists, pre-zeroed ones included. */
+extern u_long page_nfree;
+
+/* Upper bound on the number of pre-zeroed free pages kept around. */
+#define PAGE_ZERO_POOL_MAX	256
+
+struct Page_zero_stat {
+	u_long hits;		/* page_alloc_zeroed() served from the pool */
+	u_long misses;		/* page_alloc_zeroed() had to zero inline */
+	u_long zeroed;		/* pages cleaned by page_zero_idle() */
+	u_long stolen;		/* pool pages taken by a plain page_alloc() */
+};
+
+extern struct Page_zero_stat page_zero_stat;
+
+// Same-page merging (mm/ksm.c); off unless ksm_enabled is set.
+struct Ksm_stat {
+	u_long scanned;		/* pages visited by ksm_scan() */
+	u_long merged;		/* pages freed by merging into an identical one */
+	u_long zeroed;		/* zero pages unmapped, to be demand-zeroed again */
+};
+
+extern int ksm_enabled;
+extern struct Ksm_stat ksm_stat;
+
 static inline u_long
 page2ppn(struct Page *pp)
 {
 	return pp - pages;
 }
 
+static inline u_int
+page2color(struct Page *pp)
+{
+	return page2ppn(pp) & (PAGE_NCOLOR - 1);
+}
+
 static inline u_long
 page2pa(struct Page *pp)
 {
@@ -49,6 +124,14 @@ page2kva(struct Page *pp)
 }
 
 
+// Bytes of page-table memory (directory plus second-level tables)
+// behind `pgdir`.  env_free() prints it for each env it frees.
+static inline u_long
+pgdir_ptmem(Pde *pgdir)
+{
+	return (pa2page(PADDR(pgdir))->pp_live + 1) * BY2PG;
+}
+
 static inline u_long
 va2pa(Pde *pgdir, u_long va)
 {
@@ -69,15 +152,32 @@ void mips_vm_init();
 
 void mips_init();
 void page_init(void);
+int page_is_boot(struct Page *pp);
 void page_check();
 int page_alloc(struct Page **pp);
+int page_alloc_zeroed(struct Page **pp);
+int page_alloc_va(u_long va, struct Page **pp);
+int page_alloc_zeroed_va(u_long va, struct Page **pp);
+int page_zero_idle(int budget);
+void page_zero_stat_print(void);
 void page_free(struct Page *pp);
 void page_decref(struct Page *pp);
 int pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte);
+int pgdir_reserve(Pde *pgdir, u_long va, u_int npage);
+int rmap_reserve(u_int n);
 int page_insert(Pde *pgdir, struct Page *pp, u_long va, u_int perm);
 struct Page* page_lookup(Pde *pgdir, u_long va, Pte **ppte);
 void page_remove(Pde *pgdir, u_long va) ;
+void page_unmap_all(struct Page *pp);
+int page_move(Pde *src, u_long srcva, Pde *dst, u_long dstva, u_int perm);
 void tlb_invalidate(Pde *pgdir, u_long va);
+void tlb_invalidate_range(Pde *pgdir, u_long va, u_int npage);
+void tlb_flush_asid(u_int asid);
+void tlb_write(u_int entryhi, u_int entrylo);
+int page_cow_fault(Pde *pgdir, u_long va);
+int ksm_scan(int budget);
+void ksm_stat_print(void);
+int pageout(int va, int context);
 
 void boot_map_segment(Pde *pgdir, u_long va, u_long size, u_long pa, int perm);
 
@@ -0,0 +1,85 @@
+/* Single-producer/single-consumer message rings between two envs.
+ *
+ * sys_ring_create() maps one zeroed page into the caller and a peer
+ * (one of its children); the page holds two rings:
+ * RING_TO_PEER, filled by the creator, and RING_FROM_PEER, filled by
+ * the peer.  The rings are plain shared memory: messages are queued and
+ * taken without entering the kernel, in batches of any size.  The page
+ * must go where the peer has nothing mapped, which includes the zeroed
+ * pages pageout() maps ahead around each fault (see sys_ring_create).
+ *
+ * The kernel only blocks and wakes consumers.  A consumer that found
+ * its ring empty sets r_waiting, checks once more and calls
+ * sys_ring_wait(), which returns at once if the ring is no longer
+ * empty.  A producer rings the doorbell, sys_ring_notify(), only when
+ * its ring_put() took the ring from empty to non-empty while the
+ * consumer was waiting; no wakeup can be lost in between. */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include "types.h"
+
+#define RING_NSLOT	64		/* power of two */
+#define RING_MSGWORDS	4
+
+#define RING_TO_PEER	0
+#define RING_FROM_PEER	1
+
+struct Ring_msg {
+	u_int rm_w[RING_MSGWORDS];
+};
+
+struct Ring {
+	volatile u_int r_head;		/* slots filled, ever */
+	volatile u_int r_tail;		/* slots taken, ever */
+	volatile u_int r_waiting;	/* consumer is (about to be) in sys_ring_wait */
+	u_int r_pad;
+	struct Ring_msg r_slot[RING_NSLOT];
+};
+
+/* Overview:
+ *	Queue up to `n` messages from `m` on `r`.
+ *
+ * Post-Condition:
+ *	Return the number queued (fewer than `n` if the ring filled up) and
+ *	set *doorbell if the producer must now call sys_ring_notify().
+ */
+static inline int
+ring_put(struct Ring *r, const struct Ring_msg *m, int n, int *doorbell)
+{
+	u_int old = r->r_head, head = old;
+	int i;
+
+	for (i = 0; i < n && head - r->r_tail < RING_NSLOT; i++, head++) {
+		r->r_slot[head & (RING_NSLOT - 1)] = m[i];
+	}
+	r->r_head = head;
+
+	/* the ring was empty when the batch went in if the consumer had
+	 * taken everything before it; checked only after publishing */
+	*doorbell = i > 0 && r->r_tail == old && r->r_waiting;
+	return i;
+}
+
+/* Overview:
+ *	Take up to `n` messages off `r` into `m`.
+ *
+ * Post-Condition:
+ *	Return the number taken; 0 if the ring is empty.
+ */
+static inline int
+ring_get(struct Ring *r, struct Ring_msg *m, int n)
+{
+	u_int head = r->r_head, tail = r->r_tail;
+	int i;
+
+	for (i = 0; i < n && tail != head; i++, tail++) {
+		m[i] = r->r_slot[tail & (RING_NSLOT - 1)];
+	}
+
+	r->r_tail = tail;
+	return i;
+}
+
+#endif /* _RING_H_ */
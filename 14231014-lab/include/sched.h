@@ -3,8 +3,14 @@
 #ifndef __SCHED_H__
 #define __SCHED_H__
 
+#include <types.h>
+
+struct Env;
+
 void sched_init(void);
+struct Env *sched_next(u_int start);
 void sched_yield(void);
+void sched_idle(int budget);
 void sched_intr(int); 
 
 #endif /* __SCHED_H__ */
@@ -45,6 +45,8 @@
 		sw	v0,TF_CAUSE(sp)                  
 		mfc0	v0,CP0_EPC                       
 		sw	v0,TF_EPC(sp)                    
+		mfc0	v0,CP0_BADVADDR
+		sw	v0,TF_BADVADDR(sp)
 		mfhi	v0                               
 		sw	v0,TF_HI(sp)                     
 		mflo	v0                               
@@ -149,16 +151,92 @@
 .endm
 
 
+/*
+ * Traps from user mode (KUp set) move to the kernel stack at KERNEL_SP;
+ * a trap taken in the kernel stays on the stack it interrupted.  All
+ * traps share that one stack: the fixed one at 0x82000000 that timer
+ * interrupts used to get lies inside memory page_init() hands out.
+ */
 .macro get_sp
-	mfc0	k1, CP0_CAUSE
-	andi	k1, 0x107C
-	xori	k1, 0x1000
-	bnez	k1, 1f
+	mfc0	k1, CP0_STATUS
+	andi	k1, STATUS_KUP
+	beqz	k1, 1f
 	nop
-	li	sp, 0x82000000
-	j	2f
-	nop
-1:	lw	sp, KERNEL_SP
-	
-2:	nop
+	lui	sp, %hi(KERNEL_SP)
+	lw	sp, %lo(KERNEL_SP)(sp)
+1:
+.endm
+
+/*
+ * SAVE_SCRATCH/RESTORE_SCRATCH_AND_RET: the spill for exceptions whose
+ * handler is a C function that returns to the same context.  Only what
+ * the C calling convention lets the handler clobber is saved (at, v0-v1,
+ * a0-a3, t0-t9, ra, hi, lo) along with sp and the CP0 registers, in the
+ * TF_* slots of a trapframe; the handler keeps s0-s8 and gp itself.
+ * Such a handler must not switch envs unless curenv is gone.
+ */
+.macro SAVE_SCRATCH
+		move	k0, sp
+		get_sp
+		subu	sp, TF_SIZE
+		sw	k0, TF_REG29(sp)
+		sw	$1, TF_REG1(sp)
+		sw	$2, TF_REG2(sp)
+		sw	$3, TF_REG3(sp)
+		sw	$4, TF_REG4(sp)
+		sw	$5, TF_REG5(sp)
+		sw	$6, TF_REG6(sp)
+		sw	$7, TF_REG7(sp)
+		sw	$8, TF_REG8(sp)
+		sw	$9, TF_REG9(sp)
+		sw	$10, TF_REG10(sp)
+		sw	$11, TF_REG11(sp)
+		sw	$12, TF_REG12(sp)
+		sw	$13, TF_REG13(sp)
+		sw	$14, TF_REG14(sp)
+		sw	$15, TF_REG15(sp)
+		sw	$24, TF_REG24(sp)
+		sw	$25, TF_REG25(sp)
+		sw	$31, TF_REG31(sp)
+		mfc0	v0, CP0_STATUS
+		mfc0	v1, CP0_CAUSE
+		sw	v0, TF_STATUS(sp)
+		sw	v1, TF_CAUSE(sp)
+		mfc0	v0, CP0_EPC
+		mfc0	v1, CP0_BADVADDR
+		sw	v0, TF_EPC(sp)
+		sw	v1, TF_BADVADDR(sp)
+		mfhi	v0
+		mflo	v1
+		sw	v0, TF_HI(sp)
+		sw	v1, TF_LO(sp)
+.endm
+
+.macro RESTORE_SCRATCH_AND_RET
+		lw	v0, TF_HI(sp)
+		lw	v1, TF_LO(sp)
+		mthi	v0
+		mtlo	v1
+		lw	$31, TF_REG31(sp)
+		lw	$25, TF_REG25(sp)
+		lw	$24, TF_REG24(sp)
+		lw	$15, TF_REG15(sp)
+		lw	$14, TF_REG14(sp)
+		lw	$13, TF_REG13(sp)
+		lw	$12, TF_REG12(sp)
+		lw	$11, TF_REG11(sp)
+		lw	$10, TF_REG10(sp)
+		lw	$9, TF_REG9(sp)
+		lw	$8, TF_REG8(sp)
+		lw	$7, TF_REG7(sp)
+		lw	$6, TF_REG6(sp)
+		lw	$5, TF_REG5(sp)
+		lw	$4, TF_REG4(sp)
+		lw	$3, TF_REG3(sp)
+		lw	$2, TF_REG2(sp)
+		lw	$1, TF_REG1(sp)
+		lw	k0, TF_EPC(sp)
+		lw	sp, TF_REG29(sp)
+		jr	k0
+		rfe
 .endm
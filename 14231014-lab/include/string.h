@@ -0,0 +1,13 @@
+#ifndef _STRING_H_
+#define _STRING_H_
+
+#include "types.h"
+
+int strlen(const char *s);
+int strcmp(const char *p, const char *q);
+int strncmp(const char *p, const char *q, size_t n);
+char *strcpy(char *dst, const char *src);
+char *strncpy(char *dst, const char *src, size_t n);
+const char *strchr(const char *s, int c);
+
+#endif /* _STRING_H_ */
@@ -0,0 +1,48 @@
+/* See COPYRIGHT for copyright information. */
+
+#ifndef _SYSCALL_H_
+#define _SYSCALL_H_
+
+#include <unistd.h>
+
+/* syscall_table[] entries, as laid out for handle_sys (lib/syscall.S):
+ * one entry per syscall number, SC_SIZE bytes each. */
+#define SC_FN		0
+#define SC_SLOW		4
+#define SC_SHIFT	3
+#define SC_SIZE		(1 << SC_SHIFT)
+
+#ifndef __ASSEMBLER__
+
+#include <types.h>
+#include <trap.h>
+
+/* Handlers are called as fn(sysno, a1, a2, a3, a4, a5), like the user's
+ * msyscall(), and their return value goes back in v0.
+ *
+ * A syscall runs on the fast path unless sc_slow is set: only the
+ * caller's sp, ra and EPC are saved, since the handler, being a C
+ * function, keeps the callee-saved registers itself.  A handler that
+ * may block or switch envs needs the caller's full register state
+ * saved for env_run(), so it must set sc_slow. */
+struct Syscall {
+	void *sc_fn;
+	u_int sc_slow;
+};
+
+extern struct Syscall syscall_table[__NR_SYSCALLS];
+
+// sys_batch_enter() calls, and the syscalls they ran: each of those
+// but one per call is a trap saved
+struct Batch_stat {
+	u_long calls;
+	u_long entries;
+};
+extern struct Batch_stat batch_stat;
+
+void syscall_slow(struct Trapframe *tf);
+void batch_stat_print(void);
+
+#endif /* !__ASSEMBLER__ */
+
+#endif /* _SYSCALL_H_ */
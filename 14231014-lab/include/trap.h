@@ -47,6 +47,16 @@ struct Trapframe { //lr:need to be modified(reference to linux pt_regs) TODO
 };
 void *set_except_vector(int n, void * addr);
 void trap_init();
+void trap(struct Trapframe *tf);
+
+// Traps from user mode switch to the stack at KERNEL_SP (boot/start.S)
+// and save the user's registers right below it, where env_run() finds
+// them.
+extern u_long KERNEL_SP;
+#define TRAP_FRAME	((struct Trapframe *)(KERNEL_SP - sizeof(struct Trapframe)))
+
+// Page directory the TLB refill handler walks: curenv's, or 0.
+extern u_long mCONTEXT;
 
 #endif /* !__ASSEMBLER__ */
 /*
@@ -106,4 +116,39 @@ void trap_init();
  * Size of stack frame, word/double word alignment
  */
 #define TF_SIZE		((TF_PC)+4)
+
+/*
+ * The frame pgfault_upcall() (lib/traps.c) leaves on the user exception
+ * stack: the registers a C handler may clobber, as SAVE_SCRATCH saved
+ * them, for the stub at UXRET (uxret, lib/env_asm.S) to restore.  The
+ * handler runs with sp pointing at the frame, so it starts with the
+ * argument save area every callee may write.
+ */
+#define UF_ARGS		0
+#define UF_REGS		16	/* $1-$15, $24, $25, $31 */
+#define UF_HI		88
+#define UF_LO		92
+#define UF_SP		96
+#define UF_EPC		100
+#define UF_BADVADDR	104
+#define UF_SIZE		112
+
+#ifndef __ASSEMBLER__
+struct Uxframe {
+	unsigned long uf_args[4];
+	unsigned long uf_regs[18];
+	unsigned long uf_hi;
+	unsigned long uf_lo;
+	unsigned long uf_sp;
+	unsigned long uf_epc;		/* the faulting instruction */
+	unsigned long uf_badvaddr;	/* the address it wrote */
+	unsigned long uf_pad;
+};
+
+extern unsigned char uxret[], uxret_window[], uxret_end[];
+
+// where the stub's restart window lands in user space (see env_run)
+#define UXRET_WINDOW	(UXRET + (uxret_window - uxret))
+#endif /* !__ASSEMBLER__ */
+
 #endif /* _TRAP_H_ */
@@ -0,0 +1,50 @@
+/* Kernel access to curenv's memory through its own mappings.
+ *
+ * copyin() and friends (lib/uaccess.S) load and store user addresses
+ * directly, so the TLB and the refill handler do the translation.  A
+ * fault they take that trap() cannot resolve by paging in or breaking
+ * copy-on-write, such as a pointer into the kernel half or below the
+ * lowest user page, resumes at the fixup code the exception table
+ * names for the faulting instruction, which fails the access with
+ * -E_INVAL instead of panicking.
+ *
+ * Paging in is what a user touch would do, so user memory from 0x10000
+ * up to UTOP is demand-zero here too: copyin() or strncpy_from_user()
+ * of a wild pointer there maps the pages it covers (pageout(), which
+ * loads them from the program image if they lie in it, zeroed
+ * otherwise) and succeeds, reading zeroes or an empty string, instead
+ * of failing.  Only what the env itself could not touch is refused. */
+
+#ifndef _UACCESS_H_
+#define _UACCESS_H_
+
+#ifdef __ASSEMBLER__
+
+/* A fault at an instruction in [from, to) resumes at `fixup'. */
+#define EX_TABLE(from, to, fixup)		\
+	.section .ex_table, "a";		\
+	.word	from, to, fixup;		\
+	.previous
+
+#else
+
+#include <types.h>
+
+struct Ex_entry {
+	u_long ex_from;
+	u_long ex_to;
+	u_long ex_fixup;
+};
+
+// the table, collected by the linker script from every EX_TABLE()
+extern struct Ex_entry ex_table[], ex_table_end[];
+
+u_long ex_fixup(u_long pc);
+
+int copyin(void *dst, u_long usrc, u_int n);
+int copyout(u_long udst, const void *src, u_int n);
+int strncpy_from_user(char *dst, u_long usrc, u_int n);
+
+#endif /* !__ASSEMBLER__ */
+
+#endif /* _UACCESS_H_ */
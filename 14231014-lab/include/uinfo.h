@@ -0,0 +1,63 @@
+/* The kernel info page every env has mapped read-only at UINFO.
+ *
+ * env_alloc() gives each env its own page.  env_run() refreshes it
+ * each time the env is switched to, which includes every clock tick,
+ * so envs can read their ids, the time and the free memory without
+ * a syscall.  Values that change are as of the last switch.
+ *
+ * There is no cycle counter to read on the R3000 (it has no CP0 Count
+ * register), so time is kept in clock ticks of 1/ui_hz seconds. */
+
+#ifndef _UINFO_H_
+#define _UINFO_H_
+
+#include "types.h"
+#include "mmu.h"
+
+struct Uinfo {
+	u_int ui_envid;			/* this env's env_id */
+	u_int ui_parent_id;		/* its env_parent_id */
+	u_int ui_hz;			/* clock ticks per second */
+	volatile u_int ui_ticks;	/* clock ticks since boot */
+	volatile u_int ui_nfree;	/* free physical pages */
+};
+
+#define uinfo	((const struct Uinfo *)UINFO)
+
+static inline u_int
+uinfo_envid(void)
+{
+	return uinfo->ui_envid;
+}
+
+static inline u_int
+uinfo_parent_id(void)
+{
+	return uinfo->ui_parent_id;
+}
+
+static inline u_int
+uinfo_ticks(void)
+{
+	return uinfo->ui_ticks;
+}
+
+static inline u_int
+uinfo_nfree(void)
+{
+	return uinfo->ui_nfree;
+}
+
+/* Overview:
+ *	Milliseconds since boot, to the resolution of a clock tick.
+ *	Wraps around with ui_ticks.
+ */
+static inline u_int
+uinfo_time_ms(void)
+{
+	u_int t = uinfo->ui_ticks;
+
+	return t / uinfo->ui_hz * 1000 + t % uinfo->ui_hz * 1000 / uinfo->ui_hz;
+}
+
+#endif /* _UINFO_H_ */
@@ -0,0 +1,99 @@
+/* An env's own page tables, read-only at UVPT.
+ *
+ * Every page directory maps itself as the page table for UVPT (see
+ * pgdir_build in lib/env.c), so the PTE of any user va is vpt[VPN(va)]
+ * and its PDE is vpd[PDX(va)], with vpd itself the page of vpt for
+ * UVPT.  Reading an entry of vpt whose PDE is not valid faults and
+ * kills the env, so walks check vpd first.
+ *
+ * That is enough for fork() to find the pages to pass on without asking
+ * the kernel about each one: the syscalls left are the sys_mem_map()s
+ * that actually remap something, and uvpt_dup() queues those on a
+ * struct Batch (include/batch.h) to run many per trap. */
+
+#ifndef _UVPT_H_
+#define _UVPT_H_
+
+#include "types.h"
+#include "mmu.h"
+#include "unistd.h"
+#include "batch.h"
+
+#define vpt	((const volatile Pte *)UVPT)
+#define vpd	((const volatile Pde *)(UVPT + (PDX(UVPT) << PGSHIFT)))
+
+/* Overview:
+ *	Return the PTE mapping `va`, or 0 if there is no page table for it.
+ */
+static inline Pte
+uvpt_pte(u_long va)
+{
+	return (vpd[PDX(va)] & PTE_V) ? vpt[VPN(va)] : 0;
+}
+
+/* Overview:
+ *	Return the first mapped page at or after `va` and below `end`, or
+ *	`end` if there is none.  Holes without a page table are skipped a
+ *	whole PDMAP at a time.
+ */
+static inline u_long
+uvpt_next(u_long va, u_long end)
+{
+	va = ROUNDDOWN(va, BY2PG);
+
+	while (va < end) {
+		if (!(vpd[PDX(va)] & PTE_V)) {
+			va = ROUNDDOWN(va, PDMAP) + PDMAP;
+		} else if (vpt[VPN(va)] & PTE_V) {
+			return va;
+		} else {
+			va += BY2PG;
+		}
+	}
+
+	return end;
+}
+
+/* Overview:
+ *	Queue on `b` what fork() does for the page mapped at `va`: map it
+ *	into env `child`, and if it is writable, make both mappings
+ *	copy-on-write, the child's first.  Read-only and copy-on-write
+ *	pages only need the child's mapping.  UINFO is left alone, since
+ *	the child has its own, and so is the page of `b`, which the kernel
+ *	reads in place.  PTE_SHARED pages are not passed on either: a ring
+ *	links two envs only, and cannot be made copy-on-write.
+ *
+ * Post-Condition:
+ *	Return the number of entries queued (0, 1 or 2), or -1 if `b` has
+ *	no room for them, in which case nothing was queued.
+ */
+static inline int
+uvpt_dup(struct Batch *b, u_int child, u_long va)
+{
+	Pte pte = uvpt_pte(va);
+	u_int perm = pte & 0xfff;
+
+	va = ROUNDDOWN(va, BY2PG);
+	if (!(pte & PTE_V) || (pte & PTE_SHARED) || va == UINFO ||
+		va == (u_long)b) {
+		return 0;
+	}
+
+	if (!(perm & PTE_R)) {
+		if (b->b_tail - b->b_head >= BATCH_NENT) {
+			return -1;
+		}
+		batch_queue(b, SYS_mem_map, 0, va, child, va, perm);
+		return 1;
+	}
+
+	if (b->b_tail - b->b_head > BATCH_NENT - 2) {
+		return -1;
+	}
+	perm = (perm & ~PTE_R) | PTE_COW;
+	batch_queue(b, SYS_mem_map, 0, va, child, va, perm);
+	batch_queue(b, SYS_mem_map, 0, va, 0, va, perm);
+	return 2;
+}
+
+#endif /* _UVPT_H_ */
@@ -4,12 +4,18 @@
 #include <printf.h>
 #include <kclock.h>
 #include <trap.h>
+#include <initrd.h>
 
 
 void mips_init()
 {
 	printf("init.c:\tmips_init() is called\n");
 
+	mips_detect_memory();
+	mips_vm_init();
+	page_init();
+
+	env_init();
 
 	//for your degree,don't delete these.
 	//------------|
@@ -20,6 +26,20 @@ void mips_init()
 	#ifdef PTEST
 	ENV_CREATE(PTEST);
 	#endif
+
+	#ifdef PNAME
+	if (initrd_spawn(PNAME, 0) < 0) {
+		panic("no program %s in the initrd", PNAME);
+	}
+	#endif
 	//-----------|
+
+	/* the first clock tick schedules the first env */
+	trap_init();
+	kclock_init();
+
+	while (1)
+		;
+
 	panic("^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^");
 }
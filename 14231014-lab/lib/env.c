@@ -0,0 +1,858 @@
+#include <mmu.h>
+#include <error.h>
+#include <env.h>
+#include <kerelf.h>
+#include <pmap.h>
+#include <printf.h>
+#include <sched.h>
+#include <kclock.h>
+#include <uinfo.h>
+#include <asm/cp0regdef.h>
+
+struct Env *envs = NULL;		// All environments
+struct Env *curenv = NULL;	        // the current env
+struct Env_cold *env_colds = NULL;	// cold halves of envs
+
+static struct Env_list env_free_list;	// Free list
+
+// Page directories of freed envs, kept ready for env_setup_vm(): the
+// user part is already empty and the kernel part already copied in.
+// Pooled pages keep pp_ref == 1.
+static struct Page_list pgdir_pool;
+static u_int pgdir_pool_count;
+u_int pgdir_pool_max = PGDIR_POOL_MAX;
+struct Pgdir_pool_stat pgdir_pool_stat;
+
+extern Pde *boot_pgdir;
+
+struct Icode_stat icode_stat;
+
+// env_id of the env that last ran under each ASID (see ENV_ASID)
+static u_int asid_owner[NASID];
+
+
+/* Overview:
+ *  This function is for making an unique ID for every env.
+ *
+ * Pre-Condition:
+ *  Env e is exist, and e->env_id still holds the id of the slot's
+ *  previous occupant (0 if there was none).
+ *
+ * Post-Condition:
+ *  return e's envid on success.
+ */
+u_int mkenvid(struct Env *e)
+{
+	/*Hint: high bits of envid hold the slot's generation, one more than
+	 * last time. */
+	u_int gen = (ENV_GEN(e->env_id) + 1) & ENV_GEN_MASK;
+
+	if (gen == 0) {
+		gen = 1;
+	}
+
+	/*Hint: lower bits of envid hold e's position in the envs array. */
+	return (gen << LOG2NENV) | (e - envs);
+}
+
+/* Overview:
+ *  Converts an envid to an env pointer.
+ *  If envid is 0 , set *penv = curenv;otherwise set *penv = envs[ENVX(envid)];
+ *
+ * Pre-Condition:
+ *  Env penv is exist,checkperm is 0 or 1.
+ *
+ * Post-Condition:
+ *  return 0 on success,and sets *penv to the environment.
+ *  return -E_BAD_ENV on error,and sets *penv to NULL.
+ */
+int envid2env(u_int envid, struct Env **penv, int checkperm)
+{
+	struct Env *e;
+
+	if (envid == 0) {
+		*penv = curenv;
+		return 0;
+	}
+
+	e = &envs[ENVX(envid)];
+
+	if (e->env_status == ENV_FREE || e->env_id != envid) {
+		*penv = 0;
+		return -E_BAD_ENV;
+	}
+
+	/* Hint:
+	 * Check that the calling environment has legitimate permissions
+	 * to manipulate the specified environment.
+	 * If checkperm is set, the specified environment
+	 * must be either the current environment.
+	 * or an immediate child of the current environment. */
+	if (checkperm && e != curenv && e->env_parent_id != curenv->env_id) {
+		*penv = 0;
+		return -E_BAD_ENV;
+	}
+
+	*penv = e;
+	return 0;
+}
+
+/* Overview:
+ *  Find the env whose address space is `pgdir`.  The ASID recorded in
+ *  the directory's struct Page leaves only the NENV / NASID slots that
+ *  share it to look at.
+ *
+ * Post-Condition:
+ *  return the env, or 0 if `pgdir` is no env's.
+ */
+struct Env *
+pgdir2env(Pde *pgdir)
+{
+	u_int x;
+
+	for (x = pa2page(PADDR(pgdir))->pp_asid >> 6; x < NENV; x += NASID) {
+		if (envs[x].env_pgdir == pgdir) {
+			return &envs[x];
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *  Build a page directory from scratch: a zeroed page with the kernel's
+ *  shared PDEs copied in.
+ */
+static int
+pgdir_build(struct Page **pp)
+{
+	int i, r;
+	struct Page *p = NULL;
+	Pde *pgdir;
+
+	if ((r = page_alloc_zeroed(&p)) < 0) {
+		return r;
+	}
+	p->pp_ref++;
+	p->pp_live = 0;
+	pgdir = (Pde *)page2kva(p);
+
+	/* Hint:
+	 *  The VA space of all envs is identical above UTOP.
+	 *  Copy the kernel's PDEs for UENVS and UPAGES from boot_pgdir. */
+	for (i = PDX(UTOP); i < PDX(ULIM); i++) {
+		pgdir[i] = boot_pgdir[i];
+	}
+
+	/* The directory doubles as the page table for UVPT, read-only, so
+	 * the env sees its own page tables there (include/uvpt.h). */
+	pgdir[PDX(UVPT)] = page2pa(p) | PTE_V;
+
+	*pp = p;
+	return 0;
+}
+
+/* Overview:
+ *  Hand the page directory `pgdir` of a dead env back: into the pool if
+ *  there is room and it holds no page tables any more, else to the page
+ *  allocator.
+ */
+static void
+pgdir_release(Pde *pgdir)
+{
+	struct Page *p = pa2page(PADDR(pgdir));
+
+	if (pgdir_pool_count < pgdir_pool_max && p->pp_live == 0 && p->pp_ref == 1) {
+		LIST_INSERT_HEAD(&pgdir_pool, p, pp_link);
+		pgdir_pool_count++;
+		pgdir_pool_stat.recycled++;
+		return;
+	}
+
+	pgdir_pool_stat.released++;
+	page_decref(p);
+}
+
+/* Overview:
+ *  Mark all environments in 'envs' as free and insert them into the env_free_list.
+ *  Insert in reverse order,so that the first call to env_alloc() return envs[0].
+ *  env_alloc() pops and env_free() pushes at the head, so both are O(1).
+ *  Also prebuild PGDIR_POOL_PREBUILT page directories for the first envs.
+ */
+void
+env_init(void)
+{
+	struct Page *p;
+	int i;
+
+	LIST_INIT(&env_free_list);
+
+	for (i = NENV - 1; i >= 0; i--) {
+		envs[i].env_status = ENV_FREE;
+		envs[i].env_id = 0;
+		LIST_INSERT_HEAD(&env_free_list, &envs[i], env_link);
+	}
+
+	LIST_INIT(&pgdir_pool);
+	pgdir_pool_count = 0;
+
+	for (i = 0; i < PGDIR_POOL_PREBUILT && pgdir_build(&p) == 0; i++) {
+		LIST_INSERT_HEAD(&pgdir_pool, p, pp_link);
+		pgdir_pool_count++;
+	}
+}
+
+
+/* Overview:
+ *  Initialize the kernel virtual memory layout for 'e'.
+ *  Take a page directory from the pool, or build one, and set
+ *  e->env_pgdir and e->env_cr3 accordingly.  Either way the kernel
+ *  portion of the new env's address space is set up and the user
+ *  portion is empty.
+ */
+static int
+env_setup_vm(struct Env *e)
+{
+	int r;
+	struct Page *p;
+
+	if ((p = LIST_FIRST(&pgdir_pool)) != NULL) {
+		LIST_REMOVE(p, pp_link);
+		pgdir_pool_count--;
+		pgdir_pool_stat.hits++;
+	} else {
+		if ((r = pgdir_build(&p)) < 0) {
+			return r;
+		}
+		pgdir_pool_stat.misses++;
+	}
+
+	e->env_pgdir = (Pde *)page2kva(p);
+	e->env_cr3 = page2pa(p);
+
+	return 0;
+}
+
+/* Overview:
+ *  Give `e`, whose env_id and env_parent_id are set, its struct Uinfo
+ *  page, mapped read-only at UINFO.
+ */
+static int
+env_setup_info(struct Env *e)
+{
+	struct Page *p;
+	struct Uinfo *ui;
+	int r;
+
+	if ((r = page_alloc_zeroed_va(UINFO, &p)) < 0) {
+		return r;
+	}
+	if ((r = page_insert(e->env_pgdir, p, UINFO, 0)) < 0) {
+		page_free(p);
+		return r;
+	}
+	p->pp_ref++;
+
+	ui = (struct Uinfo *)page2kva(p);
+	ui->ui_envid = e->env_id;
+	ui->ui_parent_id = e->env_parent_id;
+	ui->ui_hz = KCLOCK_HZ;
+	env_cold(e)->env_info = (u_int)ui;
+	return 0;
+}
+
+/* Overview:
+ *  Allocates and Initializes a new environment.
+ *  On success, the new environment is stored in *new.
+ *
+ * Pre-Condition:
+ *  If the new Env doesn't have parent, parent_id should be zero.
+ *  env_init has been called before this function.
+ *
+ * Post-Condition:
+ *  return 0 on success, and set appropriate values for Env new.
+ *  return -E_NO_FREE_ENV on error, if no free env.
+ */
+int
+env_alloc(struct Env **new, u_int parent_id)
+{
+	int r;
+	struct Env *e;
+	struct Env_cold *c;
+
+	if ((e = LIST_FIRST(&env_free_list)) == NULL) {
+		return -E_NO_FREE_ENV;
+	}
+
+	if ((r = env_setup_vm(e)) < 0) {
+		return r;
+	}
+
+	e->env_id = mkenvid(e);
+	e->env_parent_id = parent_id;
+	e->env_status = ENV_RUNNABLE;
+	e->env_asid = ENV_ASID(e->env_id);
+	pa2page(e->env_cr3)->pp_asid = e->env_asid;
+	e->env_runs = 0;
+	e->env_pgfaults = 0;
+	e->env_prefaulted = 0;
+
+	c = env_cold(e);
+	c->env_ipc_recving = 0;
+	c->env_ring_wait = 0;
+	c->env_pgfault_handler = 0;
+	c->env_xstacktop = 0;
+	c->env_batch = 0;
+	c->env_info = 0;
+	c->env_nseg = 0;
+
+	if ((r = env_setup_info(e)) < 0) {
+		pgdir_release(e->env_pgdir);
+		e->env_pgdir = 0;
+		e->env_cr3 = 0;
+		e->env_status = ENV_FREE;
+		return r;
+	}
+
+	/* Start in user mode with interrupts enabled once env_pop_tf's rfe
+	 * shifts KUp/IEp into KUc/IEc, and without CU0, so CP0 stays out
+	 * of reach; the user stack starts at USTACKTOP. */
+	bzero(&c->env_tf, sizeof(c->env_tf));
+	c->env_tf.cp0_status = STATUS_USER;
+	c->env_tf.regs[29] = USTACKTOP;
+
+	LIST_REMOVE(e, env_link);
+	*new = e;
+	return 0;
+}
+
+/* Overview:
+ *  Can the page at `pva` of a segment loaded from `bin` be mapped
+ *  read-only straight from the kernel image (no allocation, no copy)?
+ *  It can when the segment is read-only, its file bytes run to the end
+ *  of the page and the image byte for the page start is itself page
+ *  aligned, which holds for any ELF binary that is page aligned in the
+ *  kernel (see ENV_CREATE).
+ */
+static int
+icode_can_share(u_long pva, u_long va, u_char *bin, u_int32_t bin_size,
+				u_int32_t flags)
+{
+	return !(flags & PF_W) && pva + BY2PG <= va + bin_size &&
+		   ((u_long)(bin + (pva - va)) & (BY2PG - 1)) == 0;
+}
+
+/* Overview:
+ *  Bring the page at `pva` of one PT_LOAD segment into env `env`.
+ *
+ *  The page is shared from the image if icode_can_share() allows it.
+ *  Otherwise it gets a private page: file bytes are copied in and the
+ *  bss tail is zero.  A page shared between two segments, one of which
+ *  was mapped read-only from the image, is turned into a private copy
+ *  first.  Private pages are writable only if a segment on them is.
+ */
+static int
+load_icode_page(struct Env *env, u_long pva, u_long va, u_int32_t sgsize,
+				u_char *bin, u_int32_t bin_size, u_int32_t flags)
+{
+	struct Page *p, *np;
+	Pte *pte;
+	u_long lo, hi, fend = va + bin_size, mend = va + sgsize;
+	u_int perm = (flags & PF_W) ? PTE_R : 0;
+	int r, fresh = 0;
+
+	lo = pva < va ? va : pva;
+	hi = pva + BY2PG < mend ? pva + BY2PG : mend;
+
+	p = page_lookup(env->env_pgdir, pva, &pte);
+
+	if (p == 0 && icode_can_share(pva, va, bin, bin_size, flags)) {
+		p = pa2page(PADDR(bin + (pva - va)));
+		if ((r = page_insert(env->env_pgdir, p, pva, 0)) < 0) {
+			return r;
+		}
+		icode_stat.shared++;
+		return 0;
+	}
+
+	if (p == 0 || page_is_boot(p)) {
+		if ((r = page_alloc_zeroed_va(pva, &np)) < 0) {
+			return r;
+		}
+		if (p) {
+			bcopy_page((void *)page2kva(p), (void *)page2kva(np));
+		} else {
+			fresh = 1;
+		}
+		if ((r = page_insert(env->env_pgdir, np, pva, perm)) < 0) {
+			page_free(np);
+			return r;
+		}
+		icode_stat.copied++;
+		p = np;
+	} else if (perm && !(*pte & PTE_R)) {
+		/* our own copy, read-only so far, and this segment is not */
+		if ((r = page_insert(env->env_pgdir, p, pva, perm)) < 0) {
+			return r;
+		}
+	}
+
+	if (lo < fend) {
+		bcopy(bin + (lo - va), (void *)(page2kva(p) + (lo - pva)),
+			  (hi < fend ? hi : fend) - lo);
+	}
+	if (!fresh && hi > fend) {
+		lo = lo > fend ? lo : fend;
+		bzero((void *)(page2kva(p) + (lo - pva)), hi - lo);
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *  Mapper for load_elf(): bring one PT_LOAD segment into env `user_data`
+ *  right away, page by page.
+ */
+static int
+load_icode_mapper(u_long va, u_int32_t sgsize, u_char *bin,
+				  u_int32_t bin_size, u_int32_t flags, void *user_data)
+{
+	struct Env *env = (struct Env *)user_data;
+	u_long pva;
+	int r;
+
+	for (pva = ROUNDDOWN(va, BY2PG); pva < va + sgsize; pva += BY2PG) {
+		if ((r = load_icode_page(env, pva, va, sgsize, bin, bin_size, flags)) < 0) {
+			return r;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *  Mapper for load_elf() in lazy mode: only record the segment in env
+ *  `user_data`; env_lazy_fault() brings its pages in on first touch.
+ *
+ * Post-Condition:
+ *  return -E_INVAL if the env has no room for another segment.
+ */
+static int
+load_icode_record(u_long va, u_int32_t sgsize, u_char *bin,
+				  u_int32_t bin_size, u_int32_t flags, void *user_data)
+{
+	struct Env_cold *c = env_cold((struct Env *)user_data);
+	struct Env_seg *s;
+
+	if (c->env_nseg >= ENV_NSEG) {
+		return -E_INVAL;
+	}
+
+	s = &c->env_seg[c->env_nseg++];
+	s->es_va = va;
+	s->es_memsz = sgsize;
+	s->es_bin = bin;
+	s->es_filesz = bin_size;
+	s->es_flags = flags;
+
+	return 0;
+}
+
+/* Overview:
+ *  Materialize the page holding `va` of a lazily created env `e` from
+ *  the segments recorded by load_icode_record(): mapped from the image
+ *  if read-only, otherwise copied, with bss zero-filled.  Every segment
+ *  touching the page contributes its part.
+ *  With `share_only` set, the page is only brought in if it can be
+ *  mapped straight from the image; pageout() uses this for fault-around.
+ *
+ * Post-Condition:
+ *  return 1 if the page got mapped, 0 if it was left alone (share_only),
+ *  -E_NOT_FOUND if `va` lies in no recorded segment, or another
+ *  negative error code.
+ */
+int
+env_lazy_fault(struct Env *e, u_long va, int share_only)
+{
+	struct Env_cold *c = env_cold(e);
+	struct Env_seg *s, *hit = 0;
+	u_long pva = ROUNDDOWN(va, BY2PG);
+	int i, n = 0, r;
+
+	for (i = 0; i < c->env_nseg; i++) {
+		s = &c->env_seg[i];
+		if (pva < s->es_va + s->es_memsz && pva + BY2PG > s->es_va) {
+			hit = s;
+			n++;
+		}
+	}
+
+	if (n == 0) {
+		return -E_NOT_FOUND;
+	}
+
+	if (share_only && (n > 1 ||
+					   !icode_can_share(pva, hit->es_va, hit->es_bin,
+										hit->es_filesz, hit->es_flags))) {
+		return 0;
+	}
+
+	for (i = 0; i < c->env_nseg; i++) {
+		s = &c->env_seg[i];
+		if (pva < s->es_va + s->es_memsz && pva + BY2PG > s->es_va &&
+			(r = load_icode_page(e, pva, s->es_va, s->es_memsz, s->es_bin,
+								 s->es_filesz, s->es_flags)) < 0) {
+			return r;
+		}
+	}
+
+	icode_stat.lazy++;
+	return 1;
+}
+
+/* Overview:
+ *  Does a lazily loaded segment of `e` cover the page holding `va`?  A
+ *  fault there loads the page from the image instead of mapping a
+ *  zeroed one.
+ */
+int
+env_lazy_covers(struct Env *e, u_long va)
+{
+	struct Env_cold *c = env_cold(e);
+	struct Env_seg *s;
+	u_long pva = ROUNDDOWN(va, BY2PG);
+	int i;
+
+	for (i = 0; i < c->env_nseg; i++) {
+		s = &c->env_seg[i];
+		if (pva < s->es_va + s->es_memsz && pva + BY2PG > s->es_va) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *  Sets up the the initial stack and program binary for a user process.
+ *  This function loads the binary image by using elf loader, handing
+ *  each segment to `map`: load_icode_mapper copies it into the
+ *  environment's user memory, load_icode_record only remembers it.
+ *  The entry point of the binary image is given by the elf loader.
+ *  And this function maps one page for the program's initial stack at
+ *  virtual address USTACKTOP - BY2PG.
+ */
+static void
+load_icode(struct Env *e, u_char *binary, u_int size, elf_mapper_t map)
+{
+	struct Page *p = NULL;
+	u_long entry_point;
+	int r;
+
+	if ((r = page_alloc_zeroed_va(USTACKTOP - BY2PG, &p)) < 0) {
+		panic("load_icode - alloc stack error\n");
+	}
+
+	if ((r = page_insert(e->env_pgdir, p, USTACKTOP - BY2PG, PTE_R)) < 0) {
+		panic("load_icode - map stack error\n");
+	}
+
+	if ((r = load_elf(binary, size, &entry_point, e, map)) < 0) {
+		panic("load_icode - load_elf error %d\n", r);
+	}
+
+	env_cold(e)->env_tf.pc = entry_point;
+}
+
+/* Overview:
+ *  Allocates a new env with env_alloc, loads te named elf binary into
+ *  it with load_icode.
+ */
+void
+env_create(u_char *binary, int size)
+{
+	struct Env *e;
+
+	if (env_alloc(&e, 0) < 0) {
+		panic("env_create - env_alloc error\n");
+	}
+
+	load_icode(e, binary, size, load_icode_mapper);
+}
+
+/* Overview:
+ *  Like env_create, but the binary's segments are only recorded; each
+ *  page is loaded by pageout() the first time the env touches it.
+ *  `binary` must stay in place for the env's lifetime, which holds for
+ *  binaries embedded in the kernel image.
+ */
+void
+env_create_lazy(u_char *binary, int size)
+{
+	struct Env *e;
+
+	if (env_alloc(&e, 0) < 0) {
+		panic("env_create_lazy - env_alloc error\n");
+	}
+
+	load_icode(e, binary, size, load_icode_record);
+}
+
+/* Overview:
+ *  Turn env `e`, typically one that has run its initialization, into a
+ *  template for env_clone().  The template stops running, and all of
+ *  its writable pages become copy-on-write, so clones can share them
+ *  with it and with each other until someone writes (page_cow_fault).
+ *
+ * Post-Condition:
+ *  return 0 on success, -E_INVAL if `e` is free or already a template.
+ */
+int
+env_snapshot(struct Env *e)
+{
+	Pde *pgdir = e->env_pgdir;
+	Pte *pt;
+	u_int pdeno, pteno;
+	u_long va;
+
+	if (e->env_status == ENV_FREE || e->env_status == ENV_TEMPLATE) {
+		return -E_INVAL;
+	}
+
+	for (pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+		if (!(pgdir[pdeno] & PTE_V)) {
+			continue;
+		}
+
+		pt = (Pte *)KADDR(PTE_ADDR(pgdir[pdeno]));
+
+		for (pteno = 0; pteno <= PTX(~0); pteno++) {
+			if ((pt[pteno] & (PTE_V | PTE_R)) == (PTE_V | PTE_R)) {
+				va = (pdeno << 22) | (pteno << PGSHIFT);
+				tlb_invalidate(pgdir, va);
+				pt[pteno] = (pt[pteno] & ~PTE_R) | PTE_COW;
+			}
+		}
+	}
+
+	e->env_status = ENV_TEMPLATE;
+	return 0;
+}
+
+/* Overview:
+ *  Create a new env from template `tmpl` (see env_snapshot): same
+ *  registers, same address space, with every page shared until written.
+ *  Only page table entries are copied, no page contents.  Segments of a
+ *  lazily loaded template are inherited, so the clone can still fault
+ *  in what the template never touched.  The clone keeps its own UINFO
+ *  page.
+ *
+ * Post-Condition:
+ *  return 0 on success and set *new to the clone;
+ *  return -E_INVAL if `tmpl` is not a template, or the error from
+ *  env_alloc() / page_insert().
+ */
+int
+env_clone(struct Env *tmpl, struct Env **new)
+{
+	struct Env *e;
+	struct Env_cold *c, *t;
+	Pte *pt;
+	u_int pdeno, pteno;
+	u_long va;
+	int r;
+
+	if (tmpl->env_status != ENV_TEMPLATE) {
+		return -E_INVAL;
+	}
+
+	if ((r = env_alloc(&e, tmpl->env_parent_id)) < 0) {
+		return r;
+	}
+
+	for (pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+		if (!(tmpl->env_pgdir[pdeno] & PTE_V)) {
+			continue;
+		}
+
+		pt = (Pte *)KADDR(PTE_ADDR(tmpl->env_pgdir[pdeno]));
+
+		for (pteno = 0; pteno <= PTX(~0); pteno++) {
+			va = (pdeno << 22) | (pteno << PGSHIFT);
+			if (!(pt[pteno] & PTE_V) || va == UINFO) {
+				continue;
+			}
+			if ((r = page_insert(e->env_pgdir, pa2page(pt[pteno]), va,
+								 pt[pteno] & 0xfff & ~PTE_V)) < 0) {
+				env_free(e);
+				return r;
+			}
+		}
+	}
+
+	c = env_cold(e);
+	t = env_cold(tmpl);
+	c->env_tf = t->env_tf;
+	c->env_pgfault_handler = t->env_pgfault_handler;
+	c->env_xstacktop = t->env_xstacktop;
+	c->env_nseg = t->env_nseg;
+	bcopy(t->env_seg, c->env_seg, sizeof(c->env_seg));
+
+	*new = e;
+	return 0;
+}
+
+/* Overview:
+ *  Frees env e and all memory it uses.
+ */
+void
+env_free(struct Env *e)
+{
+	Pte *pt;
+	u_int pdeno, pteno;
+	Pde *pgdir = e->env_pgdir;
+	struct Env_cold *c = env_cold(e);
+	struct Env_seg *s;
+	u_long pva, last = 0;
+	int i;
+
+	printf("[%08x] free env %08x, %d KB of page tables\n",
+		   curenv ? curenv->env_id : 0, e->env_id, pgdir_ptmem(pgdir) / 1024);
+
+	/* Count lazily loaded pages that were never faulted in.  ELF keeps
+	 * PT_LOAD segments sorted by address, so `last` stops a page
+	 * shared by two segments from being counted twice. */
+	for (i = 0; i < c->env_nseg; i++) {
+		s = &c->env_seg[i];
+		pva = ROUNDDOWN(s->es_va, BY2PG);
+		if (pva < last) {
+			pva = last;
+		}
+		for (; pva < s->es_va + s->es_memsz; pva += BY2PG) {
+			if (page_lookup(pgdir, pva, 0) == 0) {
+				icode_stat.untouched++;
+			}
+		}
+		last = pva;
+	}
+	c->env_nseg = 0;
+
+	if (c->env_batch) {
+		page_decref(pa2page(PADDR(c->env_batch)));
+		c->env_batch = 0;
+	}
+	if (c->env_info) {
+		page_decref(pa2page(PADDR(c->env_info)));
+		c->env_info = 0;
+	}
+
+	/* Unmap every user page.  page_remove() releases a page table as
+	 * soon as its last entry goes, which also clears the PDE. */
+	for (pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+		if (!(pgdir[pdeno] & PTE_V)) {
+			continue;
+		}
+
+		pt = (Pte *)KADDR(PTE_ADDR(pgdir[pdeno]));
+
+		for (pteno = 0; pteno <= PTX(~0) && (pgdir[pdeno] & PTE_V); pteno++) {
+			if (pt[pteno] & PTE_V) {
+				page_remove(pgdir, (pdeno << 22) | (pteno << PGSHIFT));
+			}
+		}
+
+		/* a table that never held a mapping is still hooked up */
+		if (pgdir[pdeno] & PTE_V) {
+			pgdir[pdeno] = 0;
+			pa2page(PADDR(pgdir))->pp_live--;
+			page_decref(pa2page(PADDR(pt)));
+		}
+	}
+
+	e->env_pgdir = 0;
+	e->env_cr3 = 0;
+	pgdir_release(pgdir);
+
+	/* drop its entries now: the pages behind them are free */
+	tlb_flush_asid(e->env_asid);
+
+	e->env_status = ENV_FREE;
+	LIST_INSERT_HEAD(&env_free_list, e, env_link);
+}
+
+/* Overview:
+ *  Frees env e, and runs another env if e was the current one.
+ */
+void
+env_destroy(struct Env *e)
+{
+	env_free(e);
+
+	if (curenv == e) {
+		curenv = NULL;
+		mCONTEXT = 0;
+		sched_yield();
+	}
+}
+
+extern void env_pop_tf(struct Trapframe *tf, u_int asid);
+
+/* Overview:
+ *  Keep curenv's registers, saved at TRAP_FRAME by the trap that brought
+ *  us here, in its env_tf, to resume it after that trap.
+ *
+ * Pre-Condition:
+ *  curenv is not NULL, and the trap saved the full trapframe.
+ */
+void
+env_save(void)
+{
+	struct Env_cold *c = env_cold(curenv);
+
+	bcopy(TRAP_FRAME, &c->env_tf, sizeof(struct Trapframe));
+	c->env_tf.pc = c->env_tf.cp0_epc;
+}
+
+/* Overview:
+ *  Switch to env e.  curenv's registers are kept in its env_tf first
+ *  (env_save).
+ *
+ * Pre-Condition:
+ *  The trap saved the full trapframe (see handle_sys for the syscalls
+ *  that do not), or curenv is NULL.
+ *
+ * Post-Condition:
+ *  Does not return.
+ */
+void
+env_run(struct Env *e)
+{
+	struct Env_cold *c;
+	struct Uinfo *ui;
+
+	if (curenv) {
+		env_save();
+	}
+
+	/* k0/k1 are gone: restart uxret's last steps (lib/env_asm.S) */
+	c = env_cold(e);
+	if (c->env_tf.pc - UXRET_WINDOW < (u_long)(uxret_end - uxret_window)) {
+		c->env_tf.pc = UXRET_WINDOW;
+	}
+
+	ui = (struct Uinfo *)c->env_info;
+	ui->ui_ticks = kclock_ticks;
+	ui->ui_nfree = page_nfree;
+
+	/* the TLB may still hold another env's entries under this ASID */
+	if (asid_owner[e->env_asid >> 6] != e->env_id) {
+		tlb_flush_asid(e->env_asid);
+		asid_owner[e->env_asid >> 6] = e->env_id;
+	}
+
+	curenv = e;
+	curenv->env_runs++;
+	mCONTEXT = (u_long)e->env_pgdir;
+
+	env_pop_tf(&c->env_tf, e->env_asid);
+}
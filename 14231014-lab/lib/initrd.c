@@ -0,0 +1,247 @@
+/* Lookup of user programs in the initrd archive linked into the kernel.
+ * See include/initrd.h for the archive layout. */
+
+#include <mmu.h>
+#include <error.h>
+#include <env.h>
+#include <string.h>
+#include <printf.h>
+#include <initrd.h>
+
+extern u_char initrd_start[], initrd_end[];
+
+static struct Initrd_hdr *initrd_hdr;
+static u_int *initrd_bucket;
+static struct Initrd_ent *initrd_ent;
+
+// where each entry's program image is (or, if compressed, will be)
+static u_char *initrd_data[INITRD_MAXENT];
+static u_char initrd_ready[INITRD_MAXENT];
+
+
+/* Overview:
+ *	Check the archive header and locate the index.
+ *
+ * Post-Condition:
+ *	Return 0 if the archive is usable, -E_INVAL otherwise.
+ */
+static int
+initrd_check(void)
+{
+	struct Initrd_hdr *h = (struct Initrd_hdr *)initrd_start;
+	u_int i;
+
+	if (initrd_end - initrd_start < sizeof(*h) ||
+		h->ih_magic != INITRD_MAGIC ||
+		h->ih_size > initrd_end - initrd_start ||
+		h->ih_nent > INITRD_MAXENT ||
+		h->ih_nbucket == 0 || (h->ih_nbucket & (h->ih_nbucket - 1)) ||
+		sizeof(*h) + h->ih_nbucket * sizeof(u_int) +
+		h->ih_nent * sizeof(struct Initrd_ent) > h->ih_size) {
+		return -E_INVAL;
+	}
+
+	initrd_bucket = (u_int *)(h + 1);
+	initrd_ent = (struct Initrd_ent *)(initrd_bucket + h->ih_nbucket);
+
+	for (i = 0; i < h->ih_nbucket; i++) {
+		if (initrd_bucket[i] != INITRD_NIL && initrd_bucket[i] >= h->ih_nent) {
+			return -E_INVAL;
+		}
+	}
+
+	for (i = 0; i < h->ih_nent; i++) {
+		if (initrd_ent[i].ie_off + initrd_ent[i].ie_size > h->ih_size ||
+			(initrd_ent[i].ie_next != INITRD_NIL &&
+			 initrd_ent[i].ie_next >= h->ih_nent)) {
+			return -E_INVAL;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Return how many bytes of contiguous memory initrd_init() needs to
+ *	inflate every compressed program in the archive.
+ */
+u_int
+initrd_cache_size(void)
+{
+	struct Initrd_hdr *h = (struct Initrd_hdr *)initrd_start;
+	u_int i, n = 0;
+
+	if (initrd_check() < 0) {
+		return 0;
+	}
+
+	for (i = 0; i < h->ih_nent; i++) {
+		if (initrd_ent[i].ie_flags & INITRD_Z) {
+			n += ROUND(initrd_ent[i].ie_rawsize, BY2PG);
+		}
+	}
+
+	return n;
+}
+
+/* Overview:
+ *	Set up the archive index.  `cache` is a page-aligned block of
+ *	initrd_cache_size() bytes; each compressed program gets its own
+ *	page-aligned part of it, filled in on first lookup.
+ */
+void
+initrd_init(void *cache)
+{
+	struct Initrd_ent *ie;
+	u_char *p = cache;
+	u_int i;
+
+	if (initrd_check() < 0) {
+		printf("initrd: no valid archive\n");
+		return;
+	}
+
+	initrd_hdr = (struct Initrd_hdr *)initrd_start;
+
+	for (i = 0; i < initrd_hdr->ih_nent; i++) {
+		ie = &initrd_ent[i];
+
+		if (ie->ie_flags & INITRD_Z) {
+			initrd_data[i] = p;
+			p += ROUND(ie->ie_rawsize, BY2PG);
+		} else {
+			initrd_data[i] = initrd_start + ie->ie_off;
+			initrd_ready[i] = 1;
+		}
+	}
+
+	printf("initrd: %d programs\n", initrd_hdr->ih_nent);
+}
+
+/* Overview:
+ *	Inflate the LZSS stream `src` of `srclen` bytes into exactly
+ *	`dstlen` bytes at `dst`.
+ *
+ *	The stream is a sequence of groups: a flag byte, then eight items,
+ *	the lowest flag bit first.  A set bit is a literal byte; a clear bit
+ *	is a two-byte match b0 b1 copying (b1 & 0xf) + INITRD_LZ_MIN bytes
+ *	from ((b1 & 0xf0) << 4 | b0) + 1 bytes back.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL if the stream is corrupt.
+ */
+static int
+initrd_inflate(const u_char *src, u_int srclen, u_char *dst, u_int dstlen)
+{
+	const u_char *send = src + srclen;
+	u_int n = 0, flags = 0, off, len;
+
+	while (n < dstlen) {
+		if (((flags >>= 1) & 0x100) == 0) {
+			if (src >= send) {
+				return -E_INVAL;
+			}
+			flags = *src++ | 0xff00;
+		}
+
+		if (flags & 1) {
+			if (src >= send) {
+				return -E_INVAL;
+			}
+			dst[n++] = *src++;
+			continue;
+		}
+
+		if (src + 2 > send) {
+			return -E_INVAL;
+		}
+		off = ((src[1] & 0xf0) << 4 | src[0]) + 1;
+		len = (src[1] & 0x0f) + INITRD_LZ_MIN;
+		src += 2;
+
+		if (off > n || len > dstlen - n) {
+			return -E_INVAL;
+		}
+		while (len--) {
+			dst[n] = dst[n - off];
+			n++;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Find the program called `name`: one hash, then a walk of its
+ *	(usually one entry long) chain.  A compressed program is inflated
+ *	the first time it is asked for and kept for later lookups.
+ *
+ * Post-Condition:
+ *	Return 0 and set *binary and *size to the page-aligned ELF image on
+ *	success; -E_NOT_FOUND if there is no such program, -E_INVAL if its
+ *	data is corrupt.
+ */
+int
+initrd_lookup(const char *name, u_char **binary, u_int *size)
+{
+	struct Initrd_ent *ie;
+	u_int h = initrd_hash(name);
+	u_int i;
+	int r;
+
+	if (initrd_hdr == 0) {
+		return -E_NOT_FOUND;
+	}
+
+	for (i = initrd_bucket[h & (initrd_hdr->ih_nbucket - 1)];
+		 i != INITRD_NIL; i = ie->ie_next) {
+		ie = &initrd_ent[i];
+		if (ie->ie_hash == h &&
+			strncmp(ie->ie_name, name, INITRD_NAMELEN) == 0) {
+			break;
+		}
+	}
+
+	if (i == INITRD_NIL) {
+		return -E_NOT_FOUND;
+	}
+
+	if (!initrd_ready[i]) {
+		if ((r = initrd_inflate(initrd_start + ie->ie_off, ie->ie_size,
+								initrd_data[i], ie->ie_rawsize)) < 0) {
+			return r;
+		}
+		initrd_ready[i] = 1;
+	}
+
+	*binary = initrd_data[i];
+	*size = (ie->ie_flags & INITRD_Z) ? ie->ie_rawsize : ie->ie_size;
+	return 0;
+}
+
+/* Overview:
+ *	Create an env running the initrd program called `name`, loading it
+ *	with env_create_lazy() if `lazy` is set.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or the error from initrd_lookup().
+ */
+int
+initrd_spawn(const char *name, int lazy)
+{
+	u_char *binary;
+	u_int size;
+	int r;
+
+	if ((r = initrd_lookup(name, &binary, &size)) < 0) {
+		return r;
+	}
+
+	if (lazy) {
+		env_create_lazy(binary, size);
+	} else {
+		env_create(binary, size);
+	}
+
+	return 0;
+}
@@ -0,0 +1,29 @@
+#include <kclock.h>
+
+extern void set_timer(void);
+
+/* Bumped by handle_int (lib/genex.S) on every tick. */
+u_int kclock_ticks;
+
+/* Overview:
+ *	Start the clock tick that preempts envs (handle_int, lib/genex.S).
+ */
+void
+kclock_init(void)
+{
+	set_timer();
+}
+
+/* Overview:
+ *	Read the RTC's wall clock, in microseconds.  It wraps around every
+ *	71 minutes or so, so only the difference of two readings means
+ *	anything.  Under GXemul this is host time: it tells how long the
+ *	emulated code ran, not how many cycles an R3000 would spend on it.
+ */
+u_int
+kclock_usec(void)
+{
+	*(volatile u_int *)IO_RTC_READ = 0;
+	return *(volatile u_int *)IO_RTC_SEC * 1000000 +
+		   *(volatile u_int *)IO_RTC_USEC;
+}
@@ -0,0 +1,77 @@
+/* This is a simplified ELF loader for the kernel.  It walks the program
+ * headers of an image in memory and hands each PT_LOAD segment to a
+ * mapper callback, which decides how the pages reach the env. */
+
+#include <kerelf.h>
+#include <error.h>
+
+/* Overview:
+ *	Check whether `binary` starts with the ELF magic.
+ *
+ * Post-Condition:
+ *	Return 1 if it does, 0 otherwise.
+ */
+int
+is_elf_format(u_char *binary)
+{
+	Elf32_Ehdr *ehdr = (Elf32_Ehdr *)binary;
+
+	return ehdr->e_ident[EI_MAG0] == ELFMAG0 &&
+		   ehdr->e_ident[EI_MAG1] == ELFMAG1 &&
+		   ehdr->e_ident[EI_MAG2] == ELFMAG2 &&
+		   ehdr->e_ident[EI_MAG3] == ELFMAG3;
+}
+
+/* Overview:
+ *	Parse the ELF image at `binary` and call `map` for every PT_LOAD
+ *	segment, then store the entry point in *entry_point.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL if the image is malformed, or the
+ *	first error returned by `map`.
+ */
+int
+load_elf(u_char *binary, int size, u_long *entry_point, void *user_data,
+		 elf_mapper_t map)
+{
+	Elf32_Ehdr *ehdr = (Elf32_Ehdr *)binary;
+	Elf32_Phdr *phdr;
+	u_char *ptr_ph_table;
+	Elf32_Half ph_entry_count;
+	Elf32_Half ph_entry_size;
+	int r;
+
+	if (size < sizeof(Elf32_Ehdr) || !is_elf_format(binary)) {
+		return -E_INVAL;
+	}
+
+	ptr_ph_table = binary + ehdr->e_phoff;
+	ph_entry_count = ehdr->e_phnum;
+	ph_entry_size = ehdr->e_phentsize;
+
+	if (ehdr->e_phoff + ph_entry_count * ph_entry_size > size) {
+		return -E_INVAL;
+	}
+
+	while (ph_entry_count--) {
+		phdr = (Elf32_Phdr *)ptr_ph_table;
+
+		if (phdr->p_type == PT_LOAD) {
+			if (phdr->p_offset + phdr->p_filesz > size ||
+				phdr->p_filesz > phdr->p_memsz) {
+				return -E_INVAL;
+			}
+			r = map(phdr->p_vaddr, phdr->p_memsz,
+					binary + phdr->p_offset, phdr->p_filesz,
+					phdr->p_flags, user_data);
+			if (r < 0) {
+				return r;
+			}
+		}
+
+		ptr_ph_table += ph_entry_size;
+	}
+
+	*entry_point = ehdr->e_entry;
+	return 0;
+}
@@ -10,6 +10,7 @@
  */
 
 #include	<print.h>
+#include	<string.h>
 
 /* macros */
 #define		IsDigit(x)	( ((x) >= '0') && ((x) <= '9') )
@@ -257,9 +258,7 @@ int
 PrintString(char * buf, char* s, int length, int ladjust)
 {
     int i;
-    int len=0;
-    char* s1 = s;
-    while (*s1++) len++;
+    int len = strlen(s);
     if (length < len) length = len;
 
     if (ladjust) {
@@ -0,0 +1,69 @@
+#include <env.h>
+#include <pmap.h>
+#include <printf.h>
+#include <sched.h>
+
+/* background work done when curenv is the only env left to run, or
+ * between interrupts when there is none (sched_idle) */
+#define SCHED_IDLE_ZERO		4	/* pages for page_zero_idle() */
+#define SCHED_IDLE_KSM		64	/* pages for ksm_scan() */
+
+/* Overview:
+ *	Find the first runnable env in `envs` from slot `start` on, wrapping
+ *	around.  Only the hot halves of the envs are read.
+ *
+ * Post-Condition:
+ *	Return the env, or 0 if none is runnable.
+ */
+struct Env *
+sched_next(u_int start)
+{
+	struct Env *e;
+	u_int i;
+
+	for (i = 0; i < NENV; i++) {
+		e = &envs[(start + i) & (NENV - 1)];
+		if (e->env_status == ENV_RUNNABLE) {
+			return e;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Run the next runnable env after curenv, round-robin over `envs`;
+ *	curenv itself comes last.  When it is the only runnable env, some
+ *	of its time goes to pre-zeroing free pages and same-page merging
+ *	first.
+ *
+ *	When no env is runnable, as when all of them are blocked in
+ *	sys_ipc_recv() or sys_ring_wait(), curenv is put aside and the
+ *	kernel idles with interrupts on, pre-zeroing free pages, until a
+ *	clock tick's sched_yield() finds an env to run.
+ *
+ * Post-Condition:
+ *	Does not return.
+ */
+void
+sched_yield(void)
+{
+	struct Env *e;
+
+	if ((e = sched_next(curenv ? curenv - envs + 1 : 0)) != 0) {
+		if (e == curenv) {
+			page_zero_idle(SCHED_IDLE_ZERO);
+			ksm_scan(SCHED_IDLE_KSM);
+		}
+
+		env_run(e);
+	}
+
+	if (curenv) {
+		env_save();
+		curenv = NULL;
+		mCONTEXT = 0;
+	}
+
+	sched_idle(SCHED_IDLE_ZERO);
+}
@@ -0,0 +1,206 @@
+/*
+ * Kernel string routines.
+ *
+ * The scans read aligned words and use the usual has-zero-byte test
+ *
+ *	(w - 0x01010101) & ~w & 0x80808080
+ *
+ * which is non-zero iff some byte of w is zero.  A word that trips the
+ * test (or differs, for comparisons) is finished byte by byte, so the
+ * result never depends on byte order.  Aligned word reads cannot cross a
+ * page boundary, so reading past the terminator inside its word is safe.
+ */
+
+#include <string.h>
+
+#define ONES		0x01010101
+#define HIGHS		0x80808080
+#define HASZERO(w)	(((w) - ONES) & ~(w) & HIGHS)
+
+#define ALIGNED(p)	((((u_long)(p)) & 3) == 0)
+
+int
+strlen(const char *s)
+{
+	const char *p = s;
+	const u_int *w;
+
+	while (!ALIGNED(p)) {
+		if (*p == 0) {
+			return p - s;
+		}
+		p++;
+	}
+
+	for (w = (const u_int *)p; !HASZERO(*w); w++)
+		;
+
+	for (p = (const char *)w; *p; p++)
+		;
+
+	return p - s;
+}
+
+int
+strcmp(const char *p, const char *q)
+{
+	const u_int *wp, *wq;
+
+	if (((u_long)p & 3) == ((u_long)q & 3)) {
+		while (!ALIGNED(p)) {
+			if (*p == 0 || *p != *q) {
+				goto bytes;
+			}
+			p++, q++;
+		}
+
+		wp = (const u_int *)p;
+		wq = (const u_int *)q;
+		while (*wp == *wq && !HASZERO(*wp)) {
+			wp++, wq++;
+		}
+		p = (const char *)wp;
+		q = (const char *)wq;
+	}
+
+bytes:
+	while (*p && *p == *q) {
+		p++, q++;
+	}
+
+	return (int)(u_char)*p - (int)(u_char)*q;
+}
+
+int
+strncmp(const char *p, const char *q, size_t n)
+{
+	const u_int *wp, *wq;
+
+	if (((u_long)p & 3) == ((u_long)q & 3)) {
+		while (n > 0 && !ALIGNED(p)) {
+			if (*p == 0 || *p != *q) {
+				goto bytes;
+			}
+			p++, q++, n--;
+		}
+
+		wp = (const u_int *)p;
+		wq = (const u_int *)q;
+		while (n >= 4 && *wp == *wq && !HASZERO(*wp)) {
+			wp++, wq++, n -= 4;
+		}
+		p = (const char *)wp;
+		q = (const char *)wq;
+	}
+
+bytes:
+	while (n > 0 && *p && *p == *q) {
+		p++, q++, n--;
+	}
+
+	if (n == 0) {
+		return 0;
+	}
+
+	return (int)(u_char)*p - (int)(u_char)*q;
+}
+
+char *
+strcpy(char *dst, const char *src)
+{
+	char *ret = dst;
+	u_int *wd;
+	const u_int *ws;
+
+	if (((u_long)dst & 3) == ((u_long)src & 3)) {
+		while (!ALIGNED(src)) {
+			if ((*dst++ = *src++) == 0) {
+				return ret;
+			}
+		}
+
+		wd = (u_int *)dst;
+		ws = (const u_int *)src;
+		while (!HASZERO(*ws)) {
+			*wd++ = *ws++;
+		}
+		dst = (char *)wd;
+		src = (const char *)ws;
+	}
+
+	while ((*dst++ = *src++) != 0)
+		;
+
+	return ret;
+}
+
+/* Like the C library version: copies at most n bytes and pads the rest
+ * of dst with zeros; dst is not terminated if src is n bytes or longer. */
+char *
+strncpy(char *dst, const char *src, size_t n)
+{
+	char *ret = dst;
+	u_int *wd;
+	const u_int *ws;
+
+	if (((u_long)dst & 3) == ((u_long)src & 3)) {
+		while (n > 0 && !ALIGNED(src)) {
+			n--;
+			if ((*dst++ = *src++) == 0) {
+				goto pad;
+			}
+		}
+
+		wd = (u_int *)dst;
+		ws = (const u_int *)src;
+		while (n >= 4 && !HASZERO(*ws)) {
+			*wd++ = *ws++;
+			n -= 4;
+		}
+		dst = (char *)wd;
+		src = (const char *)ws;
+	}
+
+	while (n > 0) {
+		n--;
+		if ((*dst++ = *src++) == 0) {
+			break;
+		}
+	}
+
+pad:
+	while (n > 0) {
+		*dst++ = 0;
+		n--;
+	}
+
+	return ret;
+}
+
+const char *
+strchr(const char *s, int c)
+{
+	u_int m = (u_char)c * ONES;
+	const u_int *w;
+
+	while (!ALIGNED(s)) {
+		if (*s == (char)c) {
+			return s;
+		}
+		if (*s == 0) {
+			return 0;
+		}
+		s++;
+	}
+
+	for (w = (const u_int *)s; !HASZERO(*w) && !HASZERO(*w ^ m); w++)
+		;
+
+	for (s = (const char *)w; *s; s++) {
+		if (*s == (char)c) {
+			return s;
+		}
+	}
+
+	return (char)c == 0 ? s : 0;
+}
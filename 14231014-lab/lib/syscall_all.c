@@ -0,0 +1,907 @@
+#include <env.h>
+#include <pmap.h>
+#include <printf.h>
+#include <sched.h>
+#include <syscall.h>
+#include <error.h>
+#include <ring.h>
+#include <batch.h>
+#include <uaccess.h>
+#include <asm/cp0regdef.h>
+
+extern void printcharc(char ch);
+extern char scancharc(void);
+
+typedef int (*syscall_fn_t)(u_int, u_int, u_int, u_int, u_int, u_int);
+
+struct Batch_stat batch_stat;
+
+/* Overview:
+ *	Check `perm`, asked of a syscall for a user mapping of the page
+ *	whose entry is `*pte` (or of a fresh page if `pte` is 0): it may only
+ *	hold PTE_V, PTE_R and PTE_COW, a read-only or copy-on-write page
+ *	cannot be mapped writable, and a PTE_SHARED page cannot be mapped
+ *	copy-on-write.
+ *
+ * Post-Condition:
+ *	Return 0 if `perm` may be used, else -E_INVAL.
+ */
+static int
+check_perm(u_int perm, Pte *pte)
+{
+	if (perm & ~(PTE_V | PTE_R | PTE_COW)) {
+		return -E_INVAL;
+	}
+
+	if (pte && (perm & PTE_R) && !(*pte & PTE_R)) {
+		return -E_INVAL;
+	}
+
+	/* a ring made copy-on-write would come apart on the next write */
+	if (pte && (perm & PTE_COW) && (*pte & PTE_SHARED)) {
+		return -E_INVAL;
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Print the character `c` on the console.
+ */
+int
+sys_putchar(int sysno, int c)
+{
+	printcharc((char)c);
+	return 0;
+}
+
+/* Overview:
+ *	Return the current env's envid.
+ */
+u_int
+sys_getenvid(void)
+{
+	return curenv->env_id;
+}
+
+/* Overview:
+ *	Give up the rest of the time slice: run the next env.
+ *
+ * Post-Condition:
+ *	Does not return; the caller resumes after its syscall later on.
+ */
+void
+sys_yield(void)
+{
+	sched_yield();
+}
+
+/* Overview:
+ *	Destroy the env `envid` (the caller or one of its children).
+ *
+ * Post-Condition:
+ *	Return 0 on success, < 0 on error.  Does not return if the caller
+ *	destroyed itself.
+ */
+int
+sys_env_destroy(int sysno, u_int envid)
+{
+	struct Env *e;
+	int r;
+
+	if ((r = envid2env(envid, &e, 1)) < 0) {
+		return r;
+	}
+
+	printf("[%08x] destroying %08x\n", curenv->env_id, e->env_id);
+	env_destroy(e);
+	return 0;
+}
+
+/* Overview:
+ *	Set the user-level page fault handler of `envid` to `func`, run on
+ *	the exception stack whose top is `xstacktop`.
+ *
+ * Post-Condition:
+ *	Return 0 on success, < 0 on error.
+ */
+int
+sys_set_pgfault_handler(int sysno, u_int envid, u_int func, u_int xstacktop)
+{
+	struct Env *e;
+	int r;
+
+	if ((r = envid2env(envid, &e, 1)) < 0) {
+		return r;
+	}
+
+	env_cold(e)->env_pgfault_handler = func;
+	env_cold(e)->env_xstacktop = xstacktop;
+	return 0;
+}
+
+/* Overview:
+ *	Map a zeroed page at `va` in the address space of `envid`, with
+ *	permissions `perm`, replacing any page already mapped there.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL if `va` is not below UTOP or `perm`
+ *	lacks PTE_V, has PTE_COW or fails check_perm(), or the error from
+ *	envid2env(),
+ *	page_alloc_zeroed_va() or page_insert().
+ */
+int
+sys_mem_alloc(int sysno, u_int envid, u_int va, u_int perm)
+{
+	struct Env *e;
+	struct Page *p;
+	int r;
+
+	if (va >= UTOP || !(perm & PTE_V) || (perm & PTE_COW) ||
+		check_perm(perm, 0) < 0) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(envid, &e, 1)) < 0) {
+		return r;
+	}
+
+	if ((r = page_alloc_zeroed_va(va, &p)) < 0) {
+		return r;
+	}
+
+	if ((r = page_insert(e->env_pgdir, p, va, perm)) < 0) {
+		page_free(p);
+		return r;
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Map the page at `srcva` in `srcid` at `dstva` in `dstid` too, with
+ *	permissions `perm` (see check_perm).
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL on a bad va or perm or if nothing is
+ *	mapped at `srcva`, or the error from envid2env() or page_insert().
+ */
+int
+sys_mem_map(int sysno, u_int srcid, u_int srcva, u_int dstid, u_int dstva,
+			u_int perm)
+{
+	struct Env *srcenv, *dstenv;
+	struct Page *p;
+	Pte *pte;
+	int r;
+
+	srcva = ROUNDDOWN(srcva, BY2PG);
+	dstva = ROUNDDOWN(dstva, BY2PG);
+
+	if (srcva >= UTOP || dstva >= UTOP || !(perm & PTE_V)) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(srcid, &srcenv, 1)) < 0 ||
+		(r = envid2env(dstid, &dstenv, 1)) < 0) {
+		return r;
+	}
+
+	if ((p = page_lookup(srcenv->env_pgdir, srcva, &pte)) == 0) {
+		return -E_INVAL;
+	}
+
+	if ((r = check_perm(perm, pte)) < 0) {
+		return r;
+	}
+
+	return page_insert(dstenv->env_pgdir, p, dstva, perm);
+}
+
+/* Overview:
+ *	Unmap the page at `va` in `envid`, if any.
+ *
+ * Post-Condition:
+ *	Return 0 on success, < 0 on error.
+ */
+int
+sys_mem_unmap(int sysno, u_int envid, u_int va)
+{
+	struct Env *e;
+	int r;
+
+	if (va >= UTOP) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(envid, &e, 1)) < 0) {
+		return r;
+	}
+
+	page_remove(e->env_pgdir, va);
+	return 0;
+}
+
+/* Overview:
+ *	Create a child of the caller with an empty address space and the
+ *	caller's registers, so it resumes from this syscall too, but with
+ *	0 as the return value.  It is not runnable until the caller says
+ *	so with sys_set_env_status().
+ *
+ * Post-Condition:
+ *	Return the child's envid to the caller, or the error from
+ *	env_alloc().
+ */
+int
+sys_env_alloc(void)
+{
+	struct Env *e;
+	struct Env_cold *c;
+	int r;
+
+	if ((r = env_alloc(&e, curenv->env_id)) < 0) {
+		return r;
+	}
+
+	c = env_cold(e);
+	bcopy(TRAP_FRAME, &c->env_tf, sizeof(struct Trapframe));
+	c->env_tf.pc = c->env_tf.cp0_epc;
+	c->env_tf.regs[2] = 0;
+	e->env_status = ENV_NOT_RUNNABLE;
+
+	return e->env_id;
+}
+
+/* Overview:
+ *	Set the status of `envid` to ENV_RUNNABLE or ENV_NOT_RUNNABLE.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL for any other status or for a
+ *	template env (see env_snapshot), or the error from envid2env().
+ */
+int
+sys_set_env_status(int sysno, u_int envid, u_int status)
+{
+	struct Env *e;
+	int r;
+
+	if (status != ENV_RUNNABLE && status != ENV_NOT_RUNNABLE) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(envid, &e, 1)) < 0) {
+		return r;
+	}
+
+	if (e->env_status == ENV_TEMPLATE) {
+		return -E_INVAL;
+	}
+
+	e->env_status = status;
+	return 0;
+}
+
+/* Overview:
+ *	Set the registers of `envid` to `*tf`; it resumes at tf->pc.
+ *	tf->cp0_status is ignored: the env always gets STATUS_USER.
+ *
+ * Post-Condition:
+ *	Return 0 on success, < 0 on error.  If the caller set its own
+ *	registers, it returns to tf->pc with v0 = tf->regs[2].
+ */
+int
+sys_set_trapframe(int sysno, u_int envid, struct Trapframe *tf)
+{
+	struct Env *e;
+	struct Trapframe utf, *dst;
+	int r;
+
+	if ((r = envid2env(envid, &e, 1)) < 0 ||
+		(r = copyin(&utf, (u_long)tf, sizeof(utf))) < 0) {
+		return r;
+	}
+
+	dst = (e == curenv) ? TRAP_FRAME : &env_cold(e)->env_tf;
+	bcopy(&utf, dst, sizeof(struct Trapframe));
+	dst->cp0_status = STATUS_USER;
+	dst->cp0_epc = dst->pc;
+
+	return (e == curenv) ? dst->regs[2] : 0;
+}
+
+/* Overview:
+ *	Panic with the caller's message `msg`, cut at 127 bytes.
+ */
+void
+sys_panic(int sysno, char *msg)
+{
+	char buf[128];
+	int n;
+
+	if ((n = strncpy_from_user(buf, (u_long)msg, sizeof(buf) - 1)) < 0) {
+		panic("[%08x] sys_panic: bad message %x", curenv->env_id, msg);
+	}
+	buf[n] = 0;
+	panic("%s", buf);
+}
+
+/* Overview:
+ *	Hand `value`, and the page at `srcva` if it is not 0, to `envid`,
+ *	which must be blocked in sys_ipc_recv(), and make it runnable.  The
+ *	page is mapped at the receiver's env_ipc_dstva with `perm`, which
+ *	check_perm() must allow for it.
+ *
+ *	Besides the env_ipc_* fields, the message goes into the registers
+ *	the receiver resumes with: v1 = value, a0 = sender, a1 = perm and
+ *	a2 = the number of pages received.
+ *
+ * Post-Condition:
+ *	Return 0 and set *pe to the receiver on success; -E_IPC_NOT_RECV
+ *	if `envid` is not receiving, -E_INVAL on a bad srcva or perm, or the error
+ *	from envid2env() or page_insert().
+ */
+static int
+ipc_deliver(u_int envid, u_int value, u_int srcva, u_int perm,
+			struct Env **pe)
+{
+	struct Env *e;
+	struct Env_cold *c;
+	struct Page *p;
+	Pte *pte = 0;
+	int r;
+
+	if (srcva >= UTOP) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(envid, &e, 0)) < 0) {
+		return r;
+	}
+
+	c = env_cold(e);
+	if (!c->env_ipc_recving) {
+		return -E_IPC_NOT_RECV;
+	}
+
+	if (srcva != 0 &&
+		(p = page_lookup(curenv->env_pgdir, srcva, &pte)) == 0) {
+		return -E_INVAL;
+	}
+
+	if ((r = check_perm(perm, pte)) < 0) {
+		return r;
+	}
+
+	if (srcva != 0) {
+		if ((r = page_insert(e->env_pgdir, p, c->env_ipc_dstva, perm)) < 0) {
+			return r;
+		}
+	}
+
+	c->env_ipc_recving = 0;
+	c->env_ipc_value = value;
+	c->env_ipc_from = curenv->env_id;
+	c->env_ipc_perm = perm;
+	c->env_ipc_npage = srcva != 0;
+	c->env_tf.regs[3] = value;
+	c->env_tf.regs[4] = curenv->env_id;
+	c->env_tf.regs[5] = perm;
+	c->env_tf.regs[6] = c->env_ipc_npage;
+	e->env_status = ENV_RUNNABLE;
+
+	*pe = e;
+	return 0;
+}
+
+/* Overview:
+ *	Send `value`, and the page at `srcva` if it is not 0, to `envid` if
+ *	it is blocked in sys_ipc_recv() (see ipc_deliver), and let the
+ *	scheduler get to it in its turn.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or the error from ipc_deliver().
+ */
+int
+sys_ipc_can_send(int sysno, u_int envid, u_int value, u_int srcva,
+				 u_int perm)
+{
+	struct Env *e;
+
+	return ipc_deliver(envid, value, srcva, perm, &e);
+}
+
+/* Overview:
+ *	Like sys_ipc_can_send(), but on success the caller gives the rest
+ *	of its time slice to the receiver and switches straight to it,
+ *	without a trip through the scheduler.  The caller stays runnable.
+ *
+ * Post-Condition:
+ *	Return the error from ipc_deliver() at once if the message cannot
+ *	be delivered.  Otherwise does not return here: the caller resumes
+ *	after its syscall with v0 = 0 when next scheduled.
+ */
+int
+sys_ipc_send(int sysno, u_int envid, u_int value, u_int srcva, u_int perm)
+{
+	struct Env *e;
+	int r;
+
+	if ((r = ipc_deliver(envid, value, srcva, perm, &e)) < 0) {
+		return r;
+	}
+
+	TRAP_FRAME->regs[2] = 0;
+	env_run(e);
+	return 0;
+}
+
+/* Overview:
+ *	Block until another env sends a value, and maybe pages, mapped from
+ *	`dstva` on.  The window takes `npage` pages (1 if 0) for
+ *	sys_ipc_send_pages(); the other senders send at most one.
+ *
+ * Post-Condition:
+ *	Return -E_INVAL at once if the window is not below UTOP or is
+ *	larger than IPC_MAXPAGE pages.  Otherwise does not return here: the
+ *	caller resumes after its syscall with v0 = 0 once the message is in
+ *	its registers (see ipc_deliver).
+ */
+int
+sys_ipc_recv(int sysno, u_int dstva, u_int npage)
+{
+	struct Env_cold *c = env_cold(curenv);
+
+	if (npage == 0) {
+		npage = 1;
+	}
+
+	if (npage > IPC_MAXPAGE || dstva >= UTOP ||
+		UTOP - dstva < npage * BY2PG) {
+		return -E_INVAL;
+	}
+
+	c->env_ipc_recving = 1;
+	c->env_ipc_dstva = dstva;
+	c->env_ipc_npage = npage;
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	TRAP_FRAME->regs[2] = 0;
+	sched_yield();
+	return 0;
+}
+
+/* Overview:
+ *	Send `value` and the `npage` pages from `srcva` to `envid`, blocked
+ *	in sys_ipc_recv() with a window at least that large; they are
+ *	mapped from its env_ipc_dstva on with `perm`.  Pages are shared
+ *	unless IPC_MOVE is set in `perm`: then they are moved, leaving the
+ *	caller's range unmapped, with no reference count or copy-on-write
+ *	changes and a single TLB flush for the range.  Pages the kernel or
+ *	another env relies on staying where they are cannot be moved: the
+ *	info page, the caller's batch page and PTE_SHARED pages (rings).
+ *
+ *	The page tables and reverse-map nodes the transfer needs are taken
+ *	first, so once the message is delivered it cannot fail half way.
+ *
+ * Post-Condition:
+ *	Return 0 on success; -E_IPC_NOT_RECV if `envid` is not receiving,
+ *	-E_INVAL on a bad range, a window too small, an unmapped source page,
+ *	a perm check_perm() refuses or a page that cannot be moved, or the
+ *	error from envid2env(), pgdir_reserve(), rmap_reserve() or
+ *	ipc_deliver().  Nothing is transferred on error.
+ */
+int
+sys_ipc_send_pages(int sysno, u_int envid, u_int value, u_int srcva,
+				   u_int npage, u_int perm)
+{
+	struct Env *e;
+	struct Env_cold *c;
+	struct Page *p;
+	Pte *pte;
+	u_int i, move = perm & IPC_MOVE;
+	int r;
+
+	perm &= ~IPC_MOVE;
+
+	if (npage == 0 || npage > IPC_MAXPAGE || (srcva & (BY2PG - 1)) ||
+		srcva >= UTOP || UTOP - srcva < npage * BY2PG) {
+		return -E_INVAL;
+	}
+
+	/* the kernel keeps writing to the info page, so it stays put */
+	if (move && srcva <= UINFO && UINFO - srcva < npage * BY2PG) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(envid, &e, 0)) < 0) {
+		return r;
+	}
+
+	c = env_cold(e);
+	if (!c->env_ipc_recving) {
+		return -E_IPC_NOT_RECV;
+	}
+	if (npage > c->env_ipc_npage || e == curenv) {
+		return -E_INVAL;
+	}
+
+	for (i = 0; i < npage; i++) {
+		if ((p = page_lookup(curenv->env_pgdir, srcva + i * BY2PG, &pte)) == 0 ||
+			check_perm(perm, pte) < 0) {
+			return -E_INVAL;
+		}
+		if (move && ((*pte & PTE_SHARED) ||
+					 page2kva(p) == env_cold(curenv)->env_batch)) {
+			return -E_INVAL;
+		}
+	}
+
+	if ((r = pgdir_reserve(e->env_pgdir, c->env_ipc_dstva, npage)) < 0 ||
+		(!move && (r = rmap_reserve(npage)) < 0)) {
+		return r;
+	}
+
+	if ((r = ipc_deliver(envid, value, 0, perm, &e)) < 0) {
+		return r;
+	}
+
+	for (i = 0; i < npage; i++) {
+		if (move) {
+			r = page_move(curenv->env_pgdir, srcva + i * BY2PG,
+						  e->env_pgdir, c->env_ipc_dstva + i * BY2PG, perm);
+		} else {
+			r = page_insert(e->env_pgdir,
+							page_lookup(curenv->env_pgdir, srcva + i * BY2PG, 0),
+							c->env_ipc_dstva + i * BY2PG, perm);
+		}
+		if (r < 0) {
+			panic("sys_ipc_send_pages: %d with the memory reserved", r);
+		}
+	}
+
+	if (move) {
+		tlb_invalidate_range(curenv->env_pgdir, srcva, npage);
+	}
+
+	c->env_ipc_npage = npage;
+	c->env_tf.regs[6] = npage;
+	return 0;
+}
+
+/* Overview:
+ *	Set up a pair of message rings (include/ring.h) with `peerid`, one
+ *	of the caller's children: a fresh page mapped writable at `va` in
+ *	the caller and at `peerva` in the child, where nothing may be
+ *	mapped yet.  Only a parent may do this, so a child cannot map
+ *	pages over its parent's.  Both mappings are PTE_SHARED, so the
+ *	page is never made copy-on-write or moved away by IPC.
+ *
+ *	A page the child never touched may still be mapped: pageout()'s
+ *	fault-around maps zeroed pages ahead in the FAULT_AROUND_PAGES
+ *	window around each page it faults in.  `peerva` should therefore
+ *	lie in a window of its own, away from the child's data and stack.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL on a bad va or if `peerva` is already
+ *	mapped in the peer, -E_BAD_ENV if `peerid` is not a child of the
+ *	caller, or the error from page_alloc_zeroed_va() or page_insert().
+ */
+int
+sys_ring_create(int sysno, u_int peerid, u_int va, u_int peerva)
+{
+	struct Env *peer;
+	struct Page *p;
+	int r;
+
+	if (va >= UTOP || peerva >= UTOP || (va | peerva) & (BY2PG - 1)) {
+		return -E_INVAL;
+	}
+
+	if ((r = envid2env(peerid, &peer, 1)) < 0) {
+		return r;
+	}
+
+	if (peer == curenv) {
+		return -E_BAD_ENV;
+	}
+
+	if (page_lookup(peer->env_pgdir, peerva, 0) != 0) {
+		return -E_INVAL;
+	}
+
+	if ((r = page_alloc_zeroed_va(va, &p)) < 0) {
+		return r;
+	}
+
+	if ((r = page_insert(curenv->env_pgdir, p, va,
+						 PTE_V | PTE_R | PTE_SHARED)) < 0) {
+		page_free(p);
+		return r;
+	}
+
+	if ((r = page_insert(peer->env_pgdir, p, peerva,
+						 PTE_V | PTE_R | PTE_SHARED)) < 0) {
+		page_remove(curenv->env_pgdir, va);
+		return r;
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Block until the ring at `va` in the caller is not empty.  The check
+ *	is made here with interrupts off, so a producer's doorbell cannot
+ *	be missed.
+ *
+ * Post-Condition:
+ *	Return 0 at once if the ring is not empty, -E_INVAL if there is no
+ *	ring at `va`.  Otherwise does not return here: the caller resumes
+ *	after its syscall with v0 = 0 once its peer rings the doorbell.
+ */
+int
+sys_ring_wait(int sysno, u_int va)
+{
+	struct Page *p;
+	struct Ring *ring;
+
+	if (va >= UTOP || (va & 3) || (va & (BY2PG - 1)) + sizeof(*ring) > BY2PG ||
+		(p = page_lookup(curenv->env_pgdir, va, 0)) == 0) {
+		return -E_INVAL;
+	}
+
+	ring = (struct Ring *)(page2kva(p) + (va & (BY2PG - 1)));
+	if (ring->r_head != ring->r_tail) {
+		return 0;
+	}
+
+	env_cold(curenv)->env_ring_wait = va;
+	curenv->env_status = ENV_NOT_RUNNABLE;
+	TRAP_FRAME->regs[2] = 0;
+	sched_yield();
+	return 0;
+}
+
+/* Overview:
+ *	Ring the doorbell of `envid`: wake it if it is blocked in
+ *	sys_ring_wait().  A spurious wakeup only makes it look at its ring.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or the error from envid2env().
+ */
+int
+sys_ring_notify(int sysno, u_int envid)
+{
+	struct Env *e;
+	struct Env_cold *c;
+	int r;
+
+	if ((r = envid2env(envid, &e, 0)) < 0) {
+		return r;
+	}
+
+	c = env_cold(e);
+	if (c->env_ring_wait != 0) {
+		c->env_ring_wait = 0;
+		e->env_status = ENV_RUNNABLE;
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Map a zeroed struct Batch (include/batch.h) at `va` in the caller
+ *	and make it the one sys_batch_enter() runs, in place of any earlier
+ *	one.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL on a bad va, or the error from
+ *	page_alloc_zeroed_va() or page_insert().
+ */
+int
+sys_batch_setup(int sysno, u_int va)
+{
+	struct Env_cold *c = env_cold(curenv);
+	struct Page *p;
+	int r;
+
+	if (va >= UTOP || (va & (BY2PG - 1))) {
+		return -E_INVAL;
+	}
+
+	if ((r = page_alloc_zeroed_va(va, &p)) < 0) {
+		return r;
+	}
+
+	if ((r = page_insert(curenv->env_pgdir, p, va, PTE_V | PTE_R)) < 0) {
+		page_free(p);
+		return r;
+	}
+
+	/* our own reference: the env may unmap the page at any time */
+	p->pp_ref++;
+	if (c->env_batch) {
+		page_decref(pa2page(PADDR(c->env_batch)));
+	}
+	c->env_batch = page2kva(p);
+
+	return 0;
+}
+
+/* Overview:
+ *	Run the syscalls queued on the caller's batch page, in order, each
+ *	as if made on its own, storing their return values.
+ *
+ * Post-Condition:
+ *	Return the number of entries run, -E_INVAL if there is no batch page
+ *	or its indices are corrupt.
+ */
+int
+sys_batch_enter(void)
+{
+	struct Batch *b = (struct Batch *)env_cold(curenv)->env_batch;
+	struct Batch_ent *be;
+	struct Syscall *sc;
+	u_int head, tail, no;
+	int n = 0;
+
+	if (b == 0) {
+		return -E_INVAL;
+	}
+
+	head = b->b_head;
+	tail = b->b_tail;
+	if (tail - head > BATCH_NENT) {
+		return -E_INVAL;
+	}
+
+	for (; head != tail; head++, n++) {
+		be = &b->b_ent[head & (BATCH_NENT - 1)];
+		no = be->be_sysno - __SYSCALL_BASE;
+		sc = no < __NR_SYSCALLS ? &syscall_table[no] : 0;
+
+		if (sc == 0 || sc->sc_fn == 0 || sc->sc_slow ||
+			be->be_sysno == SYS_batch_setup || be->be_sysno == SYS_batch_enter) {
+			be->be_ret = -E_INVAL;
+		} else {
+			be->be_ret = ((syscall_fn_t)sc->sc_fn)(be->be_sysno,
+					be->be_arg[0], be->be_arg[1], be->be_arg[2],
+					be->be_arg[3], be->be_arg[4]);
+		}
+
+		b->b_head = head + 1;
+	}
+
+	batch_stat.calls++;
+	batch_stat.entries += n;
+	return n;
+}
+
+void
+batch_stat_print(void)
+{
+	printf("batch: %d calls ran %d syscalls (%d traps saved)\n",
+		   batch_stat.calls, batch_stat.entries,
+		   batch_stat.entries - batch_stat.calls);
+}
+
+/* Overview:
+ *	Make `envid`, the caller or one of its children, a template for
+ *	sys_env_clone() (see env_snapshot): it stops running for good and
+ *	its writable pages become copy-on-write.  Clones resume where the
+ *	template would have, so a child can snapshot itself once it has
+ *	initialized, and each clone then returns 0 from this call.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or the error from envid2env() or
+ *	env_snapshot().  Does not return if the caller snapshotted itself.
+ */
+int
+sys_env_snapshot(int sysno, u_int envid)
+{
+	struct Env *e;
+	int r;
+
+	if ((r = envid2env(envid, &e, 1)) < 0 || (r = env_snapshot(e)) < 0) {
+		return r;
+	}
+
+	if (e == curenv) {
+		TRAP_FRAME->regs[2] = 0;
+		sched_yield();
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Create a clone of the template `envid`, one of the caller's
+ *	children (see env_clone).  The clone is the caller's child too, and
+ *	runnable at once.
+ *
+ * Post-Condition:
+ *	Return the clone's envid, or the error from envid2env() or
+ *	env_clone().
+ */
+int
+sys_env_clone(int sysno, u_int envid)
+{
+	struct Env *t, *e;
+	int r;
+
+	if ((r = envid2env(envid, &t, 1)) < 0 || (r = env_clone(t, &e)) < 0) {
+		return r;
+	}
+
+	return e->env_id;
+}
+
+/* Overview:
+ *	Wait for a character from the console and return it.
+ */
+char
+sys_cgetc(void)
+{
+	char ch;
+
+	while ((ch = scancharc()) == 0)
+		;
+
+	return ch;
+}
+
+#define SYSCALL(name, slow) \
+	[SYS_##name - __SYSCALL_BASE] = { (void *)sys_##name, slow }
+
+/* The handlers that may block or switch envs are marked slow. */
+struct Syscall syscall_table[__NR_SYSCALLS] __attribute__((aligned(SC_SIZE))) = {
+	SYSCALL(putchar, 0),
+	SYSCALL(getenvid, 0),
+	SYSCALL(yield, 1),
+	SYSCALL(env_destroy, 1),
+	SYSCALL(set_pgfault_handler, 0),
+	SYSCALL(mem_alloc, 0),
+	SYSCALL(mem_map, 0),
+	SYSCALL(mem_unmap, 0),
+	SYSCALL(env_alloc, 1),
+	SYSCALL(set_env_status, 0),
+	SYSCALL(set_trapframe, 1),
+	SYSCALL(panic, 0),
+	SYSCALL(ipc_can_send, 0),
+	SYSCALL(ipc_recv, 1),
+	SYSCALL(cgetc, 0),
+	SYSCALL(ipc_send, 1),
+	SYSCALL(ring_create, 0),
+	SYSCALL(ring_wait, 1),
+	SYSCALL(ring_notify, 0),
+	SYSCALL(ipc_send_pages, 0),
+	SYSCALL(batch_setup, 0),
+	SYSCALL(batch_enter, 0),
+	SYSCALL(env_snapshot, 1),
+	SYSCALL(env_clone, 0),
+};
+
+/* Overview:
+ *	Run a syscall with the caller's full trapframe `tf` saved (by
+ *	handle_sys_slow, lib/syscall.S), so the handler may block or switch
+ *	envs.  EPC is moved past the syscall first: that is where the
+ *	caller resumes, whenever it does.
+ */
+void
+syscall_slow(struct Trapframe *tf)
+{
+	u_int no = tf->regs[4] - __SYSCALL_BASE;
+	u_int arg[2];
+	syscall_fn_t fn;
+
+	tf->cp0_epc += 4;
+
+	/* the fifth and sixth arguments are on the caller's stack */
+	if (no >= __NR_SYSCALLS || syscall_table[no].sc_fn == 0 ||
+		copyin(arg, tf->regs[29] + 16, sizeof(arg)) < 0) {
+		tf->regs[2] = -E_INVAL;
+		return;
+	}
+
+	fn = (syscall_fn_t)syscall_table[no].sc_fn;
+	tf->regs[2] = fn(tf->regs[4], tf->regs[5], tf->regs[6], tf->regs[7],
+					 arg[0], arg[1]);
+}
@@ -0,0 +1,248 @@
+#include <env.h>
+#include <pmap.h>
+#include <printf.h>
+#include <error.h>
+#include <trap.h>
+#include <uaccess.h>
+#include <asm/cp0regdef.h>
+
+/* CP0 Cause ExcCode values */
+#define EXC_INT		0
+#define EXC_MOD		1
+#define EXC_TLBL	2
+#define EXC_TLBS	3
+#define EXC_SYS		8
+#define EXC_BP		9
+
+extern void handle_int(), handle_mod(), handle_tlb(), handle_sys(),
+	   handle_bp(), handle_reserved();
+
+// indexed by ExcCode in except_vec3 (lib/genex.S)
+unsigned long exception_handlers[32];
+
+u_long mCONTEXT;
+
+
+/* Overview:
+ *	Make `addr` the handler for exceptions with ExcCode `n`.
+ *
+ * Post-Condition:
+ *	Return the previous handler.
+ */
+void *
+set_except_vector(int n, void *addr)
+{
+	unsigned long old = exception_handlers[n];
+
+	exception_handlers[n] = (unsigned long)addr;
+	return (void *)old;
+}
+
+/* Overview:
+ *	Fill the exception jump table: one entry stub per cause we handle,
+ *	handle_reserved for the rest.
+ */
+void
+trap_init()
+{
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		set_except_vector(i, handle_reserved);
+	}
+
+	set_except_vector(EXC_INT, handle_int);
+	set_except_vector(EXC_MOD, handle_mod);
+	set_except_vector(EXC_TLBL, handle_tlb);
+	set_except_vector(EXC_TLBS, handle_tlb);
+	set_except_vector(EXC_SYS, handle_sys);
+	set_except_vector(EXC_BP, handle_bp);
+}
+
+/* Overview:
+ *	Load the TLB entry for the user address `va` of curenv, mapping a
+ *	page there first (pageout) if there is none.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or the error from pageout().
+ */
+static int
+do_refill(u_long va)
+{
+	Pde *pgdir = curenv->env_pgdir;
+	Pte *pte;
+	int r;
+
+	pgdir_walk(pgdir, va, 0, &pte);
+	if (pte == 0 || !(*pte & PTE_V)) {
+		if ((r = pageout(va, (int)pgdir)) < 0) {
+			return r;
+		}
+		pgdir_walk(pgdir, va, 0, &pte);
+	}
+
+	tlb_write(PTE_ADDR(va) | curenv->env_asid, *pte);
+	return 0;
+}
+
+/* Overview:
+ *	Look `pc` up in the exception table (include/uaccess.h).
+ *
+ * Post-Condition:
+ *	Return where a fault at `pc` resumes, or 0 if it is not covered.
+ */
+u_long
+ex_fixup(u_long pc)
+{
+	struct Ex_entry *ex;
+
+	for (ex = ex_table; ex < ex_table_end; ex++) {
+		if (pc >= ex->ex_from && pc < ex->ex_to) {
+			return ex->ex_fixup;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Send the write fault `tf` took in curenv to the env's page fault
+ *	handler.  The registers a C function may clobber go into a struct
+ *	Uxframe, which copyout() writes to its exception stack, below the
+ *	current frame if the handler itself faulted; the env then resumes
+ *	in the handler with sp and a0 at the frame and ra at UXRET, whose
+ *	stub restores them and retries the faulting instruction without
+ *	another trap.
+ *
+ *	Copy-on-write faults never get here: trap() resolves them in the
+ *	kernel first, so the handler only sees writes to pages that are
+ *	read-only as mapped.
+ *
+ * Post-Condition:
+ *	Return 0 if `tf` now enters the handler; -E_INVAL if there is no
+ *	handler, or its exception stack is read-only or full.  An unmapped
+ *	exception stack page is demand-zeroed, as a touch by the env would
+ *	be.
+ */
+static int
+pgfault_upcall(struct Trapframe *tf)
+{
+	struct Env_cold *c = env_cold(curenv);
+	u_long top = c->env_xstacktop, sp = tf->regs[29];
+	struct Uxframe uf;
+	int i;
+
+	if (c->env_pgfault_handler == 0 || top == 0 || top > UTOP ||
+		(top & (BY2PG - 1))) {
+		return -E_INVAL;
+	}
+
+	if (sp <= top - BY2PG || sp > top) {
+		sp = top;
+	}
+	sp = ROUNDDOWN(sp, 8) - sizeof(struct Uxframe);
+	if (sp < top - BY2PG) {
+		return -E_INVAL;
+	}
+
+	for (i = 1; i < 16; i++) {
+		uf.uf_regs[i - 1] = tf->regs[i];
+	}
+	uf.uf_regs[15] = tf->regs[24];
+	uf.uf_regs[16] = tf->regs[25];
+	uf.uf_regs[17] = tf->regs[31];
+	uf.uf_hi = tf->hi;
+	uf.uf_lo = tf->lo;
+	uf.uf_sp = tf->regs[29];
+	uf.uf_epc = tf->cp0_epc;
+	uf.uf_badvaddr = tf->cp0_badvaddr;
+
+	if (copyout(sp, &uf, sizeof(uf)) < 0) {
+		return -E_INVAL;
+	}
+
+	tf->regs[4] = sp;
+	tf->regs[29] = sp;
+	tf->regs[31] = UXRET;
+	tf->cp0_epc = c->env_pgfault_handler;
+	return 0;
+}
+
+/* Overview:
+ *	Handle the exceptions the entry stubs in lib/genex.S leave to C.
+ *	TLB misses on unmapped pages of curenv are paged in, and TLB Mod
+ *	faults break copy-on-write; a write to a page that is plainly
+ *	read-only goes to curenv's page fault handler (pgfault_upcall).  A
+ *	kernel fault on a user address in copyin() and friends is resolved
+ *	the same way if it can be, and otherwise resumes at the fixup of
+ *	the exception table.  A breakpoint is reported and skipped.
+ *	Anything else taken in user mode kills curenv: a miss that cannot
+ *	be paged in (a null pointer, or no memory left), a write with no
+ *	handler to take it, a fault between UTOP and ULIM (an unmapped UVPT
+ *	slot, say), an address error, a reserved instruction, an overflow.
+ *	Anything else taken in kernel mode panics.
+ *
+ *	`tf` is the full trapframe for handle_reserved, but only the
+ *	caller-saved part of it (SAVE_SCRATCH) for the others.
+ */
+void
+trap(struct Trapframe *tf)
+{
+	u_int code = (tf->cp0_cause >> 2) & 0x1f;
+	u_long va = tf->cp0_badvaddr;
+	u_long fix;
+
+	if (code == EXC_BP) {
+		printf("[%08x] breakpoint at %x\n", curenv ? curenv->env_id : 0,
+			   tf->cp0_epc);
+		tf->cp0_epc += 4;
+		return;
+	}
+
+	/* a user address in copyin() and friends */
+	if (!(tf->cp0_status & STATUS_KUP) && (fix = ex_fixup(tf->cp0_epc))) {
+		/* pageout() maps nothing below 0x10000 */
+		if (curenv && va >= 0x10000 && va < UTOP) {
+			if ((code == EXC_TLBL || code == EXC_TLBS) &&
+				do_refill(va) == 0) {
+				return;
+			}
+			if (code == EXC_MOD &&
+				page_cow_fault(curenv->env_pgdir, va) == 0) {
+				return;
+			}
+		}
+		tf->cp0_epc = fix;
+		return;
+	}
+
+	if (curenv && va < UTOP) {
+		switch (code) {
+		case EXC_TLBL:
+		case EXC_TLBS:
+			if (do_refill(va) == 0) {
+				return;
+			}
+			break;
+
+		case EXC_MOD:
+			if (page_cow_fault(curenv->env_pgdir, va) == 0) {
+				return;
+			}
+			if ((tf->cp0_status & STATUS_KUP) && pgfault_upcall(tf) == 0) {
+				return;
+			}
+			break;
+		}
+	}
+
+	if (curenv && (tf->cp0_status & STATUS_KUP)) {
+		printf("[%08x] exception %d: epc %x, badvaddr %x\n",
+			   curenv->env_id, code, tf->cp0_epc, va);
+		env_destroy(curenv);
+		return;
+	}
+
+	panic("unhandled exception %d: epc %x, badvaddr %x, status %x",
+		  code, tf->cp0_epc, va, tf->cp0_status);
+}
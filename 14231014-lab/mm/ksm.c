@@ -0,0 +1,298 @@
+#include "mmu.h"
+#include "pmap.h"
+#include "printf.h"
+#include "env.h"
+
+/* Same-page merging.
+ *
+ * ksm_scan() walks the physical pages a few at a time and merges user
+ * pages with identical contents into one frame, mapped copy-on-write in
+ * every address space that had a copy; page_cow_fault() splits them
+ * again on write.  Pages are matched through a direct-mapped table of
+ * content hashes, so a duplicate is found once both copies have been
+ * visited, and only then are the contents compared in full.
+ *
+ * A candidate that is all zero is not merged but unmapped everywhere
+ * through its reverse map (page_unmap_all), which frees it outright:
+ * the next touch of any of those addresses gets a fresh zeroed page
+ * from pageout(), just as it would if the page had been dropped by
+ * copy-on-write.
+ *
+ * Off unless ksm_enabled is set. */
+
+#define KSM_NSLOT	1024	/* power of two */
+
+int ksm_enabled;
+struct Ksm_stat ksm_stat;
+
+static u_long ksm_cursor;
+static struct Page *ksm_slot[KSM_NSLOT];
+static u_int ksm_slot_hash[KSM_NSLOT];
+
+
+/* Overview:
+ *	Find the PTE through which `pgdir` maps `va`.
+ */
+static Pte *
+ksm_pte(Pde *pgdir, u_long va)
+{
+	Pte *pte;
+
+	pgdir_walk(pgdir, va, 0, &pte);
+	return pte;
+}
+
+/* Overview:
+ *	Does `pgdir` map `pp` at `va`, writable or copy-on-write?
+ *
+ * Post-Condition:
+ *	Return the mapping's PTE_R and PTE_COW bits, or 0 if it is neither
+ *	or `pgdir` does not map `pp` there.
+ */
+static u_int
+ksm_mapped(Pde *pgdir, u_long va, struct Page *pp)
+{
+	Pte *pte = ksm_pte(pgdir, va);
+
+	if (pte == 0 || !(*pte & PTE_V) || PTE_ADDR(*pte) != page2pa(pp)) {
+		return 0;
+	}
+
+	return *pte & (PTE_R | PTE_COW);
+}
+
+/* Overview:
+ *	Can `pp` take part in merging?  Every reference to it must be a user
+ *	mapping on its reverse map, and every mapping must be writable or
+ *	already copy-on-write: pages mapped read-only on purpose, such as
+ *	program text shared from the kernel image, are left alone.  So are
+ *	pages with more than one writable mapping, such as rings or pages
+ *	shared with sys_mem_map(): their users expect to see each other's
+ *	writes, which copy-on-write would split apart.
+ */
+static int
+ksm_candidate(struct Page *pp)
+{
+	struct Rmap *rm;
+	u_int m, n, w;
+
+	if (pp->pp_ref == 0 || pp->pp_rpgdir == 0 ||
+		(m = ksm_mapped(pp->pp_rpgdir, pp->pp_rva, pp)) == 0) {
+		return 0;
+	}
+	n = 1;
+	w = (m & PTE_R) != 0;
+
+	for (rm = pp->pp_rmap; rm; rm = rm->rm_next) {
+		if ((m = ksm_mapped(rm->rm_pgdir, rm->rm_va, pp)) == 0) {
+			return 0;
+		}
+		n++;
+		w += (m & PTE_R) != 0;
+	}
+
+	return n == pp->pp_ref && w <= 1;
+}
+
+static u_int
+ksm_hash(struct Page *pp)
+{
+	u_int *w = (u_int *)page2kva(pp);
+	u_int h = 0;
+	int i;
+
+	for (i = 0; i < BY2PG / 4; i++) {
+		h = h * 31 + w[i];
+	}
+
+	return h;
+}
+
+static int
+ksm_same(struct Page *a, struct Page *b)
+{
+	u_int *x = (u_int *)page2kva(a), *y = (u_int *)page2kva(b);
+	int i;
+
+	for (i = 0; i < BY2PG / 4; i++) {
+		if (x[i] != y[i]) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Overview:
+ *	Would a fault at `va` in `pgdir`, were it unmapped, get a zeroed
+ *	page from pageout()?  Not if a lazily loaded segment covers it, and
+ *	the exception stack page is kept too: pgfault_upcall() writes the
+ *	fault frame there without faulting it in.
+ */
+static int
+ksm_zero_ok(Pde *pgdir, u_long va)
+{
+	struct Env *e = pgdir2env(pgdir);
+	u_long top;
+
+	if (e == 0 || env_lazy_covers(e, va)) {
+		return 0;
+	}
+
+	top = env_cold(e)->env_xstacktop;
+	return top == 0 || va >= top || va < top - BY2PG;
+}
+
+/* Overview:
+ *	Can `pp`, a candidate (see ksm_candidate), be dropped from every
+ *	address space instead of merged?  It must be all zero, and so must
+ *	whatever a fault maps in its place at each of its mappings.
+ */
+static int
+ksm_reclaimable(struct Page *pp)
+{
+	u_int *w = (u_int *)page2kva(pp);
+	struct Rmap *rm;
+	int i;
+
+	for (i = 0; i < BY2PG / 4; i++) {
+		if (w[i] != 0) {
+			return 0;
+		}
+	}
+
+	if (!ksm_zero_ok(pp->pp_rpgdir, pp->pp_rva)) {
+		return 0;
+	}
+
+	for (rm = pp->pp_rmap; rm; rm = rm->rm_next) {
+		if (!ksm_zero_ok(rm->rm_pgdir, rm->rm_va)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Overview:
+ *	Make every mapping of `pp` copy-on-write.
+ */
+static void
+ksm_protect(struct Page *pp)
+{
+	struct Rmap *rm;
+	Pte *pte;
+
+	pte = ksm_pte(pp->pp_rpgdir, pp->pp_rva);
+	if (*pte & PTE_R) {
+		tlb_invalidate(pp->pp_rpgdir, pp->pp_rva);
+		*pte = (*pte & ~PTE_R) | PTE_COW;
+	}
+
+	for (rm = pp->pp_rmap; rm; rm = rm->rm_next) {
+		pte = ksm_pte(rm->rm_pgdir, rm->rm_va);
+		if (*pte & PTE_R) {
+			tlb_invalidate(rm->rm_pgdir, rm->rm_va);
+			*pte = (*pte & ~PTE_R) | PTE_COW;
+		}
+	}
+}
+
+/* Overview:
+ *	Move every mapping of `pp` over to `into`, which has the same
+ *	contents, copy-on-write.  Dropping the last mapping frees `pp`.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or the error from page_insert(); `pp` may then
+ *	keep some of its mappings, which is harmless.
+ */
+static int
+ksm_merge(struct Page *pp, struct Page *into)
+{
+	Pde *pgdir;
+	u_long va;
+	u_int perm;
+	int r;
+
+	ksm_protect(into);
+
+	while (pp->pp_rpgdir != 0) {
+		pgdir = pp->pp_rpgdir;
+		va = pp->pp_rva;
+		perm = (*ksm_pte(pgdir, va) & 0xfff & ~(PTE_V | PTE_R)) | PTE_COW;
+
+		if ((r = page_insert(pgdir, into, va, perm)) < 0) {
+			return r;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Visit up to `budget` physical pages, merging each candidate with an
+ *	earlier-seen page of identical contents, or unmapping it if it is a
+ *	zero page that can go (ksm_reclaimable).  Meant for the idle path.
+ *
+ * Post-Condition:
+ *	Return the number of pages freed.
+ */
+int
+ksm_scan(int budget)
+{
+	struct Page *pp, *q;
+	u_int h, slot;
+	int freed = 0;
+
+	if (!ksm_enabled) {
+		return 0;
+	}
+
+	while (budget-- > 0) {
+		if (++ksm_cursor >= npage) {
+			ksm_cursor = 0;
+		}
+		pp = &pages[ksm_cursor];
+		ksm_stat.scanned++;
+
+		if (!ksm_candidate(pp)) {
+			continue;
+		}
+
+		h = ksm_hash(pp);
+
+		/* an all-zero page hashes to 0 */
+		if (h == 0 && ksm_reclaimable(pp)) {
+			page_unmap_all(pp);
+			ksm_stat.zeroed++;
+			freed++;
+			continue;
+		}
+
+		slot = h & (KSM_NSLOT - 1);
+		q = ksm_slot[slot];
+
+		if (q != 0 && q != pp && ksm_slot_hash[slot] == h &&
+			ksm_candidate(q) && q->pp_ref + pp->pp_ref < 0xffff &&
+			ksm_same(q, pp)) {
+			if (ksm_merge(pp, q) == 0) {
+				ksm_stat.merged++;
+				freed++;
+			}
+			continue;
+		}
+
+		ksm_slot[slot] = pp;
+		ksm_slot_hash[slot] = h;
+	}
+
+	return freed;
+}
+
+void
+ksm_stat_print(void)
+{
+	printf("ksm: %d pages scanned, %d merged away, %d zero pages dropped "
+		   "(%dK freed)\n", ksm_stat.scanned, ksm_stat.merged, ksm_stat.zeroed,
+		   (ksm_stat.merged + ksm_stat.zeroed) * BY2PG / 1024);
+}
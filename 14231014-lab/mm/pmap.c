@@ -0,0 +1,1063 @@
+#include "mmu.h"
+#include "pmap.h"
+#include "printf.h"
+#include "error.h"
+#include "env.h"
+#include "initrd.h"
+#include "trap.h"
+
+/* These variables are set by mips_detect_memory() */
+u_long maxpa;            /* Maximum physical address */
+u_long npage;            /* Amount of memory(in pages) */
+u_long basemem;          /* Amount of base memory(in bytes) */
+u_long extmem;           /* Amount of extended memory(in bytes) */
+
+Pde *boot_pgdir;
+
+struct Page *pages;
+static u_long freemem;
+
+/* Free lists of physical pages, one per cache color */
+static struct Page_list page_free_list[PAGE_NCOLOR];
+
+/* Free pages whose contents are already all zero, also by color.
+ * Filled by page_zero_idle(), drained first by zeroed allocations. */
+static struct Page_list page_zero_list[PAGE_NCOLOR];
+static u_long page_zero_count;
+
+u_long page_nfree;
+
+struct Page_zero_stat page_zero_stat;
+
+/* Color handed out next to allocations that have no va to match. */
+static u_int page_color_next;
+
+struct Page_color_stat page_color_stat;
+
+/* Size, in pages, of the naturally aligned window pageout() tries to
+ * fill around a faulting address.  1 disables fault-around. */
+u_int fault_around_pages = FAULT_AROUND_PAGES;
+
+/* Free Rmap nodes.  Backed by whole pages taken from page_alloc() the
+ * first time the list runs dry; those pages are never given back. */
+static struct Rmap *rmap_free_list;
+
+extern void tlb_out(u_long entryhi);
+
+
+/* Overview:
+ * 	Initialize basemem and npage.
+ * 	Set basemem to be 64MB, and calculate corresponding npage value.
+ */
+void mips_detect_memory()
+{
+	basemem = 64 * 1024 * 1024;
+	maxpa = basemem;
+	npage = maxpa >> PGSHIFT;
+	extmem = 0;
+
+	printf("Physical memory: %dK available, ", (int)(maxpa / 1024));
+	printf("base = %dK, extended = %dK\n", (int)(basemem / 1024),
+		   (int)(extmem / 1024));
+}
+
+/* Overview:
+ * 	Allocate `n` bytes physical memory with alignment `align`, if `clear` is set, clear the
+ * 	allocated memory.
+ * 	This allocator is used only while setting up virtual memory system.
+ *
+ * Post-Condition:
+ *	If we're out of memory, should panic, else return this address of memory we have allocated.
+ */
+static void *alloc(u_int n, u_int align, int clear)
+{
+	extern char end[];
+	u_long alloced_mem;
+
+	/* The first time we run, freemem is the first virtual address
+	 * the linker did not assign to any kernel code or global variables. */
+	if (freemem == 0) {
+		freemem = (u_long)end;
+	}
+
+	freemem = ROUND(freemem, align);
+	alloced_mem = freemem;
+	freemem = freemem + n;
+
+	if (PADDR(freemem) >= maxpa) {
+		panic("out of memorty\n");
+	}
+
+	if (clear) {
+		bzero((void *)alloced_mem, n);
+	}
+
+	return (void *)alloced_mem;
+}
+
+/* Overview:
+ * 	Get the page table entry for virtual address `va` in the given
+ * 	page directory `pgdir`.
+ * 	If the page table is not exist and the parameter `create` is set to 1,
+ * 	then create it.
+ */
+static Pte *boot_pgdir_walk(Pde *pgdir, u_long va, int create)
+{
+	Pde *pgdir_entryp;
+	Pte *pgtable;
+
+	pgdir_entryp = &pgdir[PDX(va)];
+
+	if ((*pgdir_entryp & PTE_V) == 0) {
+		if (!create) {
+			return 0;
+		}
+		pgtable = (Pte *)alloc(BY2PG, BY2PG, 1);
+		*pgdir_entryp = PADDR(pgtable) | PTE_V;
+	}
+
+	pgtable = (Pte *)KADDR(PTE_ADDR(*pgdir_entryp));
+	return &pgtable[PTX(va)];
+}
+
+/* Overview:
+ * 	Map [va, va+size) of virtual address space to physical [pa, pa+size) in the page
+ *	table rooted at pgdir.
+ *	Use permission bits `perm|PTE_V` for the entries.
+ */
+void boot_map_segment(Pde *pgdir, u_long va, u_long size, u_long pa, int perm)
+{
+	u_long i;
+	Pte *pgtable_entry;
+
+	for (i = 0; i < size; i += BY2PG) {
+		pgtable_entry = boot_pgdir_walk(pgdir, va + i, 1);
+		*pgtable_entry = PTE_ADDR(pa + i) | perm | PTE_V;
+	}
+}
+
+/* Overview:
+ * 	Set up two-level page table, the `pages` array and the `envs` and
+ * 	`env_colds` arrays, and map `pages` and `envs` read-only at UPAGES
+ * 	and UENVS.  Also set
+ * 	aside the memory compressed initrd programs are inflated into.
+ */
+void mips_vm_init()
+{
+	extern char end[];
+	Pde *pgdir;
+	void *stub;
+	u_int n;
+
+	pgdir = alloc(BY2PG, BY2PG, 1);
+	printf("to memory %x for struct page directory.\n", freemem);
+	boot_pgdir = pgdir;
+
+	pages = (struct Page *)alloc(npage * sizeof(struct Page), BY2PG, 1);
+	printf("to memory %x for struct Pages.\n", freemem);
+	n = ROUND(npage * sizeof(struct Page), BY2PG);
+	boot_map_segment(pgdir, UPAGES, n, PADDR(pages), 0);
+
+	/* the page fault return stub, at the far end of the same window */
+	if (n > UXRET - UPAGES) {
+		panic("struct Pages run into UXRET");
+	}
+	stub = alloc(BY2PG, BY2PG, 1);
+	bcopy(uxret, stub, uxret_end - uxret);
+	boot_map_segment(pgdir, UXRET, BY2PG, PADDR(stub), 0);
+
+	envs = (struct Env *)alloc(NENV * sizeof(struct Env), BY2PG, 1);
+	n = ROUND(NENV * sizeof(struct Env), BY2PG);
+	boot_map_segment(pgdir, UENVS, n, PADDR(envs), 0);
+
+	/* kernel only: saved registers and kernel pointers */
+	env_colds = (struct Env_cold *)alloc(NENV * sizeof(struct Env_cold), BY2PG, 1);
+
+	/* room to inflate compressed initrd programs into on first spawn */
+	initrd_init(alloc(initrd_cache_size(), BY2PG, 0));
+
+	printf("pmap.c:\t mips vm init success (kernel end %x)\n", end);
+}
+
+/* Overview:
+ * 	Initialize page structure and the memory free lists.
+ *	The `pages` array has one `struct Page` entry per physical page. Pages
+ *	are reference counted, and free pages are kept on linked lists, one
+ *	per cache color.
+ *
+ * Hint:
+ *	Pages below `freemem` hold the kernel and its boot-time allocations and
+ *	are marked used; everything above goes onto the free list of its
+ *	color, lowest address first.
+ */
+void
+page_init(void)
+{
+	u_long i, nused;
+	u_int c;
+
+	for (c = 0; c < PAGE_NCOLOR; c++) {
+		LIST_INIT(&page_free_list[c]);
+		LIST_INIT(&page_zero_list[c]);
+	}
+	page_zero_count = 0;
+	page_nfree = 0;
+
+	freemem = ROUND(freemem, BY2PG);
+	nused = PPN(PADDR(freemem));
+
+	for (i = 0; i < nused; i++) {
+		pages[i].pp_ref = 1;
+	}
+
+	for (i = npage; i > nused; i--) {
+		pages[i - 1].pp_ref = 0;
+		LIST_INSERT_HEAD(&page_free_list[page2color(&pages[i - 1])],
+						 &pages[i - 1], pp_link);
+		page_nfree++;
+	}
+}
+
+/* Overview:
+ *	Is `pp` one of the pages below freemem that page_init() keeps back,
+ *	the kernel image and what alloc() handed out at boot (inflated
+ *	initrd programs, say)?  The page allocator never returns these.
+ */
+int
+page_is_boot(struct Page *pp)
+{
+	return page2pa(pp) < PADDR(freemem);
+}
+
+/* Overview:
+ *	Take a free page, as close to `color` as possible.
+ *	Colors are tried in the order color, +1, -1, +2, -2, ... so a
+ *	shortage of one color spills onto its neighbours first.
+ *	With ALLOC_ZERO the page comes back cleared: a pre-zeroed page of
+ *	a color is preferred, then a dirty one of the same color is cleared
+ *	here (unless ALLOC_POOLED is also given).  Otherwise dirty pages are
+ *	preferred and pre-zeroed ones are only used when a color has no
+ *	dirty pages left.
+ *
+ * Post-Condition:
+ *	Return -E_NO_MEM if there is no free page at all, else set *pp and
+ *	return 0.
+ */
+#define ALLOC_ZERO	1	/* page must come back cleared */
+#define ALLOC_POOLED	2	/* ...and only from the pre-zeroed pool */
+
+static int
+page_alloc_color(u_int color, int flags, struct Page **pp)
+{
+	struct Page *ppage_temp;
+	u_int i, c;
+
+	for (i = 0; i < PAGE_NCOLOR; i++) {
+		c = (i & 1) ? color + (i + 1) / 2 : color - i / 2;
+		c &= PAGE_NCOLOR - 1;
+
+		if ((flags & ALLOC_ZERO) &&
+			(ppage_temp = LIST_FIRST(&page_zero_list[c])) != NULL) {
+			page_zero_count--;
+			page_zero_stat.hits++;
+		} else if (!(flags & ALLOC_POOLED) &&
+				   (ppage_temp = LIST_FIRST(&page_free_list[c])) != NULL) {
+			if (flags & ALLOC_ZERO) {
+				page_zero_stat.misses++;
+				bzero_page((void *)page2kva(ppage_temp));
+			}
+		} else if (!(flags & ALLOC_ZERO) &&
+				   (ppage_temp = LIST_FIRST(&page_zero_list[c])) != NULL) {
+			page_zero_count--;
+			page_zero_stat.stolen++;
+		} else {
+			continue;
+		}
+
+		if (i == 0) {
+			page_color_stat.exact++;
+		} else {
+			page_color_stat.stolen++;
+		}
+
+		LIST_REMOVE(ppage_temp, pp_link);
+		page_nfree--;
+		*pp = ppage_temp;
+		return 0;
+	}
+
+	return -E_NO_MEM;
+}
+
+/* Overview:
+ *	Allocate a physical page from the free memory.  The contents of the
+ *	page are NOT cleared; callers that hand the page to an env or use it
+ *	as a page table should call page_alloc_zeroed() instead.
+ *	Requests with no address to match rotate through the colors so they
+ *	do not all pile onto the same cache lines.
+ *
+ * Post-Condition:
+ *	If failed to allocate a new page (out of memory, there's no free page),
+ *	return -E_NO_MEM.
+ *	Else, set the address of the allocated page to *pp, and return 0.
+ *
+ * Note:
+ *	Does NOT increment the reference count of the page - the caller must do
+ *	these if necessary (either explicitly or via page_insert).
+ */
+int
+page_alloc(struct Page **pp)
+{
+	return page_alloc_color(page_color_next++, 0, pp);
+}
+
+/* Overview:
+ *	Allocate a physical page whose contents are all zero.  A page from
+ *	the pre-zeroed pool is preferred; otherwise a free page is cleared
+ *	here.
+ *
+ * Post-Condition:
+ *	Same as page_alloc().
+ */
+int
+page_alloc_zeroed(struct Page **pp)
+{
+	return page_alloc_color(page_color_next++, ALLOC_ZERO, pp);
+}
+
+/* Overview:
+ *	Like page_alloc(), but pick a page whose cache color matches the
+ *	virtual address `va` it is about to be mapped at, so that pages
+ *	adjacent in an env's address space do not collide in the
+ *	direct-mapped caches.
+ */
+int
+page_alloc_va(u_long va, struct Page **pp)
+{
+	return page_alloc_color(VA2COLOR(va), 0, pp);
+}
+
+/* Overview:
+ *	Like page_alloc_zeroed(), color-matched to `va`.
+ */
+int
+page_alloc_zeroed_va(u_long va, struct Page **pp)
+{
+	return page_alloc_color(VA2COLOR(va), ALLOC_ZERO, pp);
+}
+
+/* Overview:
+ *	Move up to `budget` free pages onto the pre-zeroed lists, clearing
+ *	each one on the way.  Meant to be called when there is nothing better
+ *	to do (e.g. the scheduler finds no runnable env), so the cost of
+ *	zeroing is kept off the page-fault path.  Colors are visited in turn
+ *	so the pool stays balanced across them.
+ *
+ * Post-Condition:
+ *	Return the number of pages zeroed.  The pool never grows beyond
+ *	PAGE_ZERO_POOL_MAX pages.
+ */
+int
+page_zero_idle(int budget)
+{
+	static u_int next;
+	struct Page *pp;
+	u_int c, empty = 0;
+	int n = 0;
+
+	while (n < budget && page_zero_count < PAGE_ZERO_POOL_MAX &&
+		   empty < PAGE_NCOLOR) {
+		c = next++ & (PAGE_NCOLOR - 1);
+		if ((pp = LIST_FIRST(&page_free_list[c])) == NULL) {
+			empty++;
+			continue;
+		}
+		empty = 0;
+		LIST_REMOVE(pp, pp_link);
+		bzero_page((void *)page2kva(pp));
+		LIST_INSERT_HEAD(&page_zero_list[c], pp, pp_link);
+		page_zero_count++;
+		n++;
+	}
+
+	page_zero_stat.zeroed += n;
+	return n;
+}
+
+/* Overview:
+ *	Print the zeroed-page pool and page coloring counters.  The hit rate
+ *	is the share of zeroed allocations that did not have to clear a page
+ *	inline.
+ */
+void
+page_zero_stat_print(void)
+{
+	u_long total = page_zero_stat.hits + page_zero_stat.misses;
+
+	printf("zero pool: %d pages, %d hits, %d misses (%d%% hit), "
+		   "%d zeroed idle, %d stolen\n",
+		   page_zero_count, page_zero_stat.hits, page_zero_stat.misses,
+		   total ? (int)(page_zero_stat.hits * 100 / total) : 0,
+		   page_zero_stat.zeroed, page_zero_stat.stolen);
+	printf("page color: %d exact, %d from a neighbouring color\n",
+		   page_color_stat.exact, page_color_stat.stolen);
+}
+
+/* Overview:
+ *	Release a page, mark it as free if it's `pp_ref` reaches 0.
+ *
+ * Hint:
+ *	The page goes back onto the dirty free list of its color; it only
+ *	reaches the pre-zeroed lists again through page_zero_idle().
+ */
+void
+page_free(struct Page *pp)
+{
+	if (pp->pp_ref > 0) {
+		return;
+	}
+
+	LIST_INSERT_HEAD(&page_free_list[page2color(pp)], pp, pp_link);
+	page_nfree++;
+}
+
+/* Overview:
+ *	Note that one more entry of the page table covering `va` is valid.
+ */
+static void
+pgtable_live_inc(Pde *pgdir, u_long va)
+{
+	pa2page(pgdir[PDX(va)])->pp_live++;
+}
+
+/* Overview:
+ *	Unhook the page table covering `va` from `pgdir` and free it.
+ */
+static void
+pgtable_free(Pde *pgdir, u_long va)
+{
+	Pde *pgdir_entryp = &pgdir[PDX(va)];
+	struct Page *ptpage = pa2page(*pgdir_entryp);
+
+	*pgdir_entryp = 0;
+	pa2page(PADDR(pgdir))->pp_live--;
+	page_decref(ptpage);
+	tlb_invalidate(pgdir, UVPT + (PDX(va) << PGSHIFT));
+}
+
+/* Overview:
+ *	Note that one entry of the page table covering `va` was cleared.  When
+ *	the last one goes, unhook the table from `pgdir` and free it.
+ *
+ * Note:
+ *	Tables built at boot time (boot_pgdir_walk) are not counted and keep
+ *	pp_live == 0; they are left alone.
+ */
+static void
+pgtable_live_dec(Pde *pgdir, u_long va)
+{
+	struct Page *ptpage = pa2page(pgdir[PDX(va)]);
+
+	if (ptpage->pp_live == 0 || --ptpage->pp_live > 0) {
+		return;
+	}
+
+	pgtable_free(pgdir, va);
+}
+
+/* Overview:
+ *	Carve up a fresh page into Rmap nodes for the slab.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_NO_MEM if there is no memory left.
+ */
+static int
+rmap_grow(void)
+{
+	struct Page *pp;
+	struct Rmap *rm;
+	u_int i;
+
+	if (page_alloc(&pp) < 0) {
+		return -E_NO_MEM;
+	}
+	pp->pp_ref = 1;
+	rm = (struct Rmap *)page2kva(pp);
+	for (i = 0; i < BY2PG / sizeof(struct Rmap); i++) {
+		rm[i].rm_next = rmap_free_list;
+		rmap_free_list = &rm[i];
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Take an Rmap node from the slab, carving up a fresh page if needed.
+ *
+ * Post-Condition:
+ *	Return 0 if there is no memory left.
+ */
+static struct Rmap *
+rmap_get(void)
+{
+	struct Rmap *rm;
+
+	if (rmap_free_list == 0 && rmap_grow() < 0) {
+		return 0;
+	}
+
+	rm = rmap_free_list;
+	rmap_free_list = rm->rm_next;
+	return rm;
+}
+
+/* Overview:
+ *	Make sure the slab has `n` free Rmap nodes, so that the next `n`
+ *	page_insert()s of pages already mapped elsewhere cannot run out of
+ *	memory for one.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_NO_MEM if there is no memory left.
+ */
+int
+rmap_reserve(u_int n)
+{
+	struct Rmap *rm;
+	u_int i;
+
+	for (;;) {
+		for (i = 0, rm = rmap_free_list; i < n && rm; rm = rm->rm_next) {
+			i++;
+		}
+		if (i == n) {
+			return 0;
+		}
+		if (rmap_grow() < 0) {
+			return -E_NO_MEM;
+		}
+	}
+}
+
+/* Overview:
+ *	Record that `pp` is mapped at `va` in `pgdir`.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_NO_MEM if no Rmap node could be allocated.
+ */
+static int
+rmap_add(struct Page *pp, Pde *pgdir, u_long va)
+{
+	struct Rmap *rm;
+
+	if (pp->pp_rpgdir == 0) {
+		pp->pp_rpgdir = pgdir;
+		pp->pp_rva = va;
+		return 0;
+	}
+
+	if ((rm = rmap_get()) == 0) {
+		return -E_NO_MEM;
+	}
+
+	rm->rm_pgdir = pgdir;
+	rm->rm_va = va;
+	rm->rm_next = pp->pp_rmap;
+	pp->pp_rmap = rm;
+	return 0;
+}
+
+/* Overview:
+ *	Forget the mapping of `pp` at `va` in `pgdir`.  If it was the inline
+ *	one, the head of the chain (if any) moves into its place.
+ */
+static void
+rmap_del(struct Page *pp, Pde *pgdir, u_long va)
+{
+	struct Rmap *rm, **prm;
+
+	va = ROUNDDOWN(va, BY2PG);
+
+	if (pp->pp_rpgdir == pgdir && pp->pp_rva == va) {
+		if ((rm = pp->pp_rmap) == 0) {
+			pp->pp_rpgdir = 0;
+			pp->pp_rva = 0;
+			return;
+		}
+		pp->pp_rpgdir = rm->rm_pgdir;
+		pp->pp_rva = rm->rm_va;
+		pp->pp_rmap = rm->rm_next;
+	} else {
+		for (prm = &pp->pp_rmap; (rm = *prm) != 0; prm = &rm->rm_next) {
+			if (rm->rm_pgdir == pgdir && rm->rm_va == va) {
+				break;
+			}
+		}
+		if (rm == 0) {
+			return;
+		}
+		*prm = rm->rm_next;
+	}
+
+	rm->rm_next = rmap_free_list;
+	rmap_free_list = rm;
+}
+
+/* Overview:
+ *	Rewrite the record of `pp` being mapped at `va` in `pgdir` to say
+ *	`nva` in `npgdir` instead; no node is allocated or freed.
+ */
+static void
+rmap_move(struct Page *pp, Pde *pgdir, u_long va, Pde *npgdir, u_long nva)
+{
+	struct Rmap *rm;
+
+	va = ROUNDDOWN(va, BY2PG);
+	nva = ROUNDDOWN(nva, BY2PG);
+
+	if (pp->pp_rpgdir == pgdir && pp->pp_rva == va) {
+		pp->pp_rpgdir = npgdir;
+		pp->pp_rva = nva;
+		return;
+	}
+
+	for (rm = pp->pp_rmap; rm; rm = rm->rm_next) {
+		if (rm->rm_pgdir == pgdir && rm->rm_va == va) {
+			rm->rm_pgdir = npgdir;
+			rm->rm_va = nva;
+			return;
+		}
+	}
+}
+
+/* Overview:
+ * 	Given `pgdir`, a pointer to a page directory, pgdir_walk returns a pointer
+ * 	to the page table entry for virtual address 'va'.  A page table it
+ * 	creates is entered in `pgdir` with PTE_V only, not PTE_R, since the
+ * 	env reads that PDE through UVPT as the PTE of the table.
+ *
+ * Pre-Condition:
+ *	The `pgdir` should be two-level page table structure.
+ *
+ * Post-Condition:
+ * 	If we're out of memory, return -E_NO_MEM.
+ *	Else, we get the page table entry successfully, store the value of page table
+ *	entry to *ppte, and return 0, indicating success.
+ *	If the page table does not exist and `create` is 0, *ppte is set to 0.
+ */
+int
+pgdir_walk(Pde *pgdir, u_long va, int create, Pte **ppte)
+{
+	Pde *pgdir_entryp;
+	Pte *pgtable;
+	struct Page *ppage;
+	int r;
+
+	pgdir_entryp = &pgdir[PDX(va)];
+
+	if ((*pgdir_entryp & PTE_V) == 0) {
+		if (!create) {
+			*ppte = 0;
+			return 0;
+		}
+		if ((r = page_alloc_zeroed(&ppage)) < 0) {
+			return r;
+		}
+		ppage->pp_ref++;
+		ppage->pp_live = 0;
+		/* no PTE_R: through UVPT this is the PTE of the table */
+		*pgdir_entryp = page2pa(ppage) | PTE_V;
+		pa2page(PADDR(pgdir))->pp_live++;
+	}
+
+	pgtable = (Pte *)KADDR(PTE_ADDR(*pgdir_entryp));
+	*ppte = &pgtable[PTX(va)];
+	return 0;
+}
+
+/* Overview:
+ *	Make sure `pgdir` has the page tables to map the `npage` pages from
+ *	`va` on, so that mapping them cannot run out of memory for one.
+ *
+ * Post-Condition:
+ *	Return 0 on success, or -E_NO_MEM, in which case the tables added
+ *	so far are freed again.
+ */
+int
+pgdir_reserve(Pde *pgdir, u_long va, u_int npage)
+{
+	u_long a, lo = ROUNDDOWN(va, PDMAP), hi = va + npage * BY2PG;
+	Pte *pte;
+	int r;
+
+	for (a = lo; a < hi; a += PDMAP) {
+		if ((r = pgdir_walk(pgdir, a, 1, &pte)) < 0) {
+			/* below UTOP, only a table just made can be empty */
+			for (a = lo; a < hi; a += PDMAP) {
+				if ((pgdir[PDX(a)] & PTE_V) &&
+					pa2page(pgdir[PDX(a)])->pp_live == 0) {
+					pgtable_free(pgdir, a);
+				}
+			}
+			return r;
+		}
+	}
+
+	return 0;
+}
+
+/* Overview:
+ * 	Map the physical page 'pp' at virtual address 'va'.
+ * 	The permissions (the low 12 bits) of the page table entry should be set to 'perm|PTE_V'.
+ *
+ * Post-Condition:
+ *	Return 0 on success
+ *	Return -E_NO_MEM, if page table couldn't be allocated
+ *
+ * Hint:
+ *	If there is already a different page mapped at `va`, drop its reference and
+ *	overwrite the entry in place.
+ *	The `pp_ref` should be incremented if the insertion succeeds.
+ */
+int
+page_insert(Pde *pgdir, struct Page *pp, u_long va, u_int perm)
+{
+	u_int PERM;
+	Pte *pgtable_entry;
+	struct Page *old;
+	int r, fresh;
+
+	PERM = perm | PTE_V;
+	fresh = !(pgdir[PDX(va)] & PTE_V);
+
+	if ((r = pgdir_walk(pgdir, va, 1, &pgtable_entry)) < 0) {
+		return r;
+	}
+
+	old = (*pgtable_entry & PTE_V) ? pa2page(*pgtable_entry) : 0;
+
+	if (old == pp) {
+		tlb_invalidate(pgdir, va);
+		*pgtable_entry = (page2pa(pp) | PERM);
+		return 0;
+	}
+
+	if ((r = rmap_add(pp, pgdir, ROUNDDOWN(va, BY2PG))) < 0) {
+		/* do not leave behind a table pgdir_walk() just made */
+		if (fresh) {
+			pgtable_free(pgdir, va);
+		}
+		return r;
+	}
+
+	if (old) {
+		/* replace in place: the table keeps the same number of live
+		 * entries, so it must not be released in between */
+		rmap_del(old, pgdir, va);
+		page_decref(old);
+	} else {
+		pgtable_live_inc(pgdir, va);
+	}
+
+	tlb_invalidate(pgdir, va);
+	*pgtable_entry = (page2pa(pp) | PERM);
+	pp->pp_ref++;
+	return 0;
+}
+
+/* Overview:
+ *	Look up the Page that virtual address `va` map to.
+ *
+ * Post-Condition:
+ *	Return a pointer to corresponding Page, and store it's page table entry to *ppte.
+ *	If `va` doesn't mapped to any Page, return NULL.
+ */
+struct Page *
+page_lookup(Pde *pgdir, u_long va, Pte **ppte)
+{
+	struct Page *ppage;
+	Pte *pte;
+
+	pgdir_walk(pgdir, va, 0, &pte);
+
+	if (pte == 0 || (*pte & PTE_V) == 0) {
+		return 0;
+	}
+
+	ppage = pa2page(*pte);
+	if (ppte) {
+		*ppte = pte;
+	}
+
+	return ppage;
+}
+
+/* Overview:
+ *	Decrease the `pp_ref` value of Page `*pp`, if `pp_ref` reaches to 0, free this page.
+ */
+void
+page_decref(struct Page *pp)
+{
+	if (--pp->pp_ref == 0) {
+		page_free(pp);
+	}
+}
+
+/* Overview:
+ * 	Unmaps the physical page at virtual address `va`.
+ */
+void
+page_remove(Pde *pgdir, u_long va)
+{
+	Pte *pagetable_entry;
+	struct Page *ppage;
+
+	ppage = page_lookup(pgdir, va, &pagetable_entry);
+
+	if (ppage == 0) {
+		return;
+	}
+
+	rmap_del(ppage, pgdir, va);
+	ppage->pp_ref--;
+	if (ppage->pp_ref == 0) {
+		page_free(ppage);
+	}
+
+	*pagetable_entry = 0;
+	tlb_invalidate(pgdir, va);
+	pgtable_live_dec(pgdir, va);
+}
+
+/* Overview:
+ *	Move the page mapped at `srcva` in `src` to `dstva` in `dst`, with
+ *	permissions `perm|PTE_V`, replacing whatever `dst` had there.  The
+ *	page keeps its reference and its reverse-map node, which is just
+ *	rewritten.  The source TLB entry is left for the caller to flush,
+ *	so that moving a run of pages takes one tlb_invalidate_range().
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL if nothing is mapped at `srcva`, or
+ *	-E_NO_MEM if `dst` needs a page table and there is no memory.
+ */
+int
+page_move(Pde *src, u_long srcva, Pde *dst, u_long dstva, u_int perm)
+{
+	struct Page *pp, *old;
+	Pte *spte, *dpte;
+	int r;
+
+	if ((pp = page_lookup(src, srcva, &spte)) == 0) {
+		return -E_INVAL;
+	}
+
+	if ((r = pgdir_walk(dst, dstva, 1, &dpte)) < 0) {
+		return r;
+	}
+
+	old = (*dpte & PTE_V) ? pa2page(*dpte) : 0;
+
+	if (old == pp) {
+		/* already mapped there too: only the source mapping goes */
+		rmap_del(pp, src, srcva);
+		pp->pp_ref--;
+	} else {
+		if (old) {
+			rmap_del(old, dst, dstva);
+			page_decref(old);
+		} else {
+			pgtable_live_inc(dst, dstva);
+		}
+		rmap_move(pp, src, srcva, dst, dstva);
+	}
+
+	tlb_invalidate(dst, dstva);
+	*dpte = page2pa(pp) | perm | PTE_V;
+
+	*spte = 0;
+	pgtable_live_dec(src, srcva);
+	return 0;
+}
+
+/* Overview:
+ *	Remove every page-table mapping of `pp`, found through its reverse
+ *	map rather than by scanning page directories.  `pp` is freed if
+ *	nothing else holds a reference to it.
+ */
+void
+page_unmap_all(struct Page *pp)
+{
+	while (pp->pp_rpgdir != 0) {
+		page_remove(pp->pp_rpgdir, pp->pp_rva);
+	}
+}
+
+/* Overview:
+ * 	Update TLB: drop the entry for `va` in `pgdir`, under the ASID of
+ * 	the env `pgdir` belongs to, which need not be curenv.
+ */
+void
+tlb_invalidate(Pde *pgdir, u_long va)
+{
+	tlb_out(PTE_ADDR(va) | pa2page(PADDR(pgdir))->pp_asid);
+}
+
+/* Overview:
+ *	Drop the TLB entries of the `npage` pages from `va` in `pgdir`: one
+ *	by one for a short run, with a single pass over the whole TLB for
+ *	the address space's ASID past TLB_RANGE_MAX pages.
+ */
+#define TLB_RANGE_MAX	8
+
+void
+tlb_invalidate_range(Pde *pgdir, u_long va, u_int npage)
+{
+	u_int i;
+
+	if (npage > TLB_RANGE_MAX) {
+		tlb_flush_asid(pa2page(PADDR(pgdir))->pp_asid);
+		return;
+	}
+
+	for (i = 0; i < npage; i++) {
+		tlb_invalidate(pgdir, va + i * BY2PG);
+	}
+}
+
+/* Overview:
+ *	Handle a write to the copy-on-write page at `va` in `pgdir` (a TLB
+ *	Mod exception): the address space gets its own writable copy, or,
+ *	if it is the page's only user left, the page is just made writable.
+ *
+ * Post-Condition:
+ *	Return 0 on success, -E_INVAL if the page is not copy-on-write, or
+ *	-E_NO_MEM if there is no page for the copy.
+ */
+int
+page_cow_fault(Pde *pgdir, u_long va)
+{
+	struct Page *pp, *np;
+	Pte *pte;
+	u_int perm;
+	int r;
+
+	if ((pp = page_lookup(pgdir, va, &pte)) == 0 || !(*pte & PTE_COW)) {
+		return -E_INVAL;
+	}
+
+	perm = (*pte & 0xfff & ~(PTE_V | PTE_COW)) | PTE_R;
+
+	if (pp->pp_ref == 1) {
+		tlb_invalidate(pgdir, va);
+		*pte = page2pa(pp) | perm | PTE_V;
+		return 0;
+	}
+
+	if ((r = page_alloc_va(va, &np)) < 0) {
+		return r;
+	}
+	bcopy_page((void *)page2kva(pp), (void *)page2kva(np));
+
+	if ((r = page_insert(pgdir, np, va, perm)) < 0) {
+		page_free(np);
+		return r;
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Handle a TLB miss on an unmapped user address `va` in the address
+ *	space `context` (a page directory KVA) by mapping a fresh zero page,
+ *	or, if `va` lies in a segment of a lazily loaded env, the page of
+ *	its binary (see env_lazy_fault).
+ *
+ *	Then fault-around: the other unmapped pages in the aligned window of
+ *	fault_around_pages pages around `va` are mapped too, but only if a
+ *	pre-zeroed page is ready for them, so the extra work is a list pop
+ *	and a PTE store per page.  Binary pages in the window are mapped
+ *	only when they can be shared from the kernel image, and are never
+ *	replaced by zero pages.  The window never leaves the faulting
+ *	page's second-level table or the user part of the address space.
+ *	Pages mapped ahead are ordinary mappings from then on: among other
+ *	things, sys_ring_create() will not place a ring over them.
+ *
+ * Post-Condition:
+ *	Return 0 once `va` is mapped; -E_INVAL if it is below 0x10000,
+ *	where nothing is ever mapped (a null pointer, say), or not below
+ *	UTOP, or if `context` is not a kernel address; or the error from
+ *	env_lazy_fault(), page_alloc_zeroed_va() or page_insert().
+ */
+int
+pageout(int va, int context)
+{
+	Pde *pgdir = (Pde *)context;
+	struct Env *e;
+	struct Page *p;
+	u_long start, end, nva;
+	Pte *pte;
+	int r;
+
+	if ((u_long)context < ULIM || (u_long)va < 0x10000 ||
+		(u_long)va >= UTOP) {
+		return -E_INVAL;
+	}
+
+	e = (curenv && curenv->env_pgdir == pgdir) ? curenv : 0;
+
+	if (e && (r = env_lazy_fault(e, va, 0)) != -E_NOT_FOUND) {
+		if (r < 0) {
+			return r;
+		}
+	} else {
+		if ((r = page_alloc_zeroed_va(va, &p)) < 0) {
+			return r;
+		}
+
+		if ((r = page_insert(pgdir, p, VA2PFN(va), PTE_R)) < 0) {
+			page_free(p);
+			return r;
+		}
+	}
+
+	if (e) {
+		e->env_pgfaults++;
+	}
+
+	if (fault_around_pages <= 1) {
+		return 0;
+	}
+
+	start = ROUNDDOWN(va, fault_around_pages * BY2PG);
+	end = start + fault_around_pages * BY2PG;
+	if (start < 0x10000) {
+		start = 0x10000;
+	}
+	if (end > UTOP) {
+		end = UTOP;
+	}
+
+	for (nva = start; nva < end; nva += BY2PG) {
+		pgdir_walk(pgdir, nva, 0, &pte);
+		if (pte == 0 || (*pte & PTE_V)) {
+			continue;
+		}
+		if (e && (r = env_lazy_fault(e, nva, 1)) != -E_NOT_FOUND) {
+			if (r > 0) {
+				e->env_prefaulted++;
+			}
+			continue;
+		}
+		if (page_alloc_color(VA2COLOR(nva), ALLOC_ZERO | ALLOC_POOLED, &p) < 0) {
+			break;
+		}
+		if (page_insert(pgdir, p, nva, PTE_R) < 0) {
+			page_free(p);
+			break;
+		}
+		if (e) {
+			e->env_prefaulted++;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Shared bits of the kernel benchmarks in this directory.  Each one is
+ * an FTEST function, run under GXemul with
+ *
+ *	make test_dir=test DEFS=-DFTEST=<name>
+ *
+ * and timed with kclock_usec(), that is, in host microseconds.  The
+ * R3000 has no cycle counter and GXemul does not model cycles, so the
+ * numbers only compare the variants one benchmark runs side by side on
+ * the same host.
+ */
+
+#ifndef _TEST_BENCH_H_
+#define _TEST_BENCH_H_
+
+#include <kclock.h>
+#include <printf.h>
+#include <types.h>
+
+struct Env;
+
+// Largest segments bench_image() builds.
+#define IMAGE_MAXTEXT	(256 * 1024)
+#define IMAGE_MAXDATA	(64 * 1024)
+
+u_char *bench_image(u_int text, u_int data, int misalign, u_int *size);
+struct Env *bench_lone_env(void);
+
+// Nanoseconds per item, for `n` items (n < 4M) that took `usec`.
+static inline u_int
+bench_ns(u_int usec, u_int n)
+{
+	return usec / n * 1000 + usec % n * 1000 / n;
+}
+
+#endif /* _TEST_BENCH_H_ */
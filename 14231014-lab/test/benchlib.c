@@ -0,0 +1,81 @@
+/*
+ * Helpers the env benchmarks share (see bench.h).
+ */
+
+#include <env.h>
+#include <kerelf.h>
+#include "bench.h"
+
+static u_char image[BY2PG + IMAGE_MAXTEXT + IMAGE_MAXDATA + 8]
+	__attribute__((aligned(BY2PG)));
+
+/* Overview:
+ *	Build an ELF image with a read-only text segment of `text` bytes at
+ *	UTEXT and a writable data segment of `data` bytes after it, followed
+ *	by a page of bss.  Both sizes are multiples of BY2PG.  The image
+ *	sits page aligned in the kernel, so load_icode can share its text
+ *	pages, unless `misalign` is set: then every page has to be copied.
+ *
+ * Post-Condition:
+ *	Return the image and set *size to its length.
+ */
+u_char *
+bench_image(u_int text, u_int data, int misalign, u_int *size)
+{
+	u_char *bin = image + (misalign ? 8 : 0);
+	Elf32_Ehdr *ehdr = (Elf32_Ehdr *)bin;
+	Elf32_Phdr *phdr = (Elf32_Phdr *)(bin + sizeof(*ehdr));
+	u_int i;
+
+	if (text > IMAGE_MAXTEXT || data > IMAGE_MAXDATA) {
+		panic("bench_image: %d + %d bytes is too large", text, data);
+	}
+
+	bzero(bin, BY2PG);
+	for (i = BY2PG; i < BY2PG + text + data; i++) {
+		bin[i] = i * 7;
+	}
+
+	ehdr->e_ident[EI_MAG0] = ELFMAG0;
+	ehdr->e_ident[EI_MAG1] = ELFMAG1;
+	ehdr->e_ident[EI_MAG2] = ELFMAG2;
+	ehdr->e_ident[EI_MAG3] = ELFMAG3;
+	ehdr->e_entry = UTEXT;
+	ehdr->e_phoff = sizeof(*ehdr);
+	ehdr->e_phentsize = sizeof(*phdr);
+	ehdr->e_phnum = 2;
+
+	phdr[0].p_type = PT_LOAD;
+	phdr[0].p_offset = BY2PG;
+	phdr[0].p_vaddr = UTEXT;
+	phdr[0].p_filesz = phdr[0].p_memsz = text;
+	phdr[0].p_flags = PF_R | PF_X;
+
+	phdr[1].p_type = PT_LOAD;
+	phdr[1].p_offset = BY2PG + text;
+	phdr[1].p_vaddr = UTEXT + text;
+	phdr[1].p_filesz = data;
+	phdr[1].p_memsz = data + BY2PG;
+	phdr[1].p_flags = PF_R | PF_W;
+
+	*size = BY2PG + text + data;
+	return bin;
+}
+
+/* Overview:
+ *	Find the one env there is.  Benchmarks run before anything else
+ *	creates envs, so this is the one env_create() just made.
+ */
+struct Env *
+bench_lone_env(void)
+{
+	u_int i;
+
+	for (i = 0; i < NENV; i++) {
+		if (envs[i].env_status != ENV_FREE) {
+			return &envs[i];
+		}
+	}
+
+	panic("bench_lone_env: no env");
+}
@@ -0,0 +1,64 @@
+/*
+ * A cold env_create() against env_clone() of a template made from the
+ * same program:
+ *
+ *	make test_dir=test DEFS=-DFTEST=clone_bench
+ *
+ * The program (see bench_image) has 64K of text and 16K of data.  Its
+ * text is shared from the kernel image either way; a clone shares the
+ * data pages with the template too, copy-on-write.  Times are per new
+ * env, memory is the free pages it took.
+ */
+
+#include <env.h>
+#include <pmap.h>
+#include "bench.h"
+
+#define NROUND		20
+#define TEXT		(64 * 1024)
+#define DATA		(16 * 1024)
+
+void
+clone_bench(void)
+{
+	struct Env *tmpl, *e;
+	u_char *bin;
+	u_int size, round, nfree, t, create = 0, clone = 0, ncreate, nclone;
+
+	bin = bench_image(TEXT, DATA, 0, &size);
+
+	/* the first round of each only warms the page directory pool */
+	for (round = 0; round <= NROUND; round++) {
+		nfree = page_nfree;
+		t = kclock_usec();
+		env_create(bin, size);
+		t = kclock_usec() - t;
+		create += round > 0 ? t : 0;
+		ncreate = nfree - page_nfree;
+		env_free(bench_lone_env());
+	}
+
+	env_create(bin, size);
+	tmpl = bench_lone_env();
+	if (env_snapshot(tmpl) < 0) {
+		panic("clone_bench: env_snapshot failed");
+	}
+
+	for (round = 0; round <= NROUND; round++) {
+		nfree = page_nfree;
+		t = kclock_usec();
+		if (env_clone(tmpl, &e) < 0) {
+			panic("clone_bench: env_clone failed");
+		}
+		t = kclock_usec() - t;
+		clone += round > 0 ? t : 0;
+		nclone = nfree - page_nfree;
+		env_free(e);
+	}
+
+	env_free(tmpl);
+
+	printf("env_create %d us, %d pages\tenv_clone %d us, %d pages\n",
+		   create / NROUND, ncreate, clone / NROUND, nclone);
+	printf("clone_bench: done\n");
+}
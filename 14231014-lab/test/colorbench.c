@@ -0,0 +1,111 @@
+/*
+ * How well page coloring keeps a working set out of its own way in the
+ * direct-mapped caches:
+ *
+ *	make test_dir=test DEFS=-DFTEST=color_bench
+ *
+ * GXemul does not model cache timing, so misses cannot be measured
+ * there.  This counts what decides them instead: after the free lists
+ * have been churned, how many pages of a working set at consecutive
+ * addresses share a cache color with another page of the set.  It
+ * does so for pages taken with page_alloc_va(), and for pages of random
+ * colors, which is what a color-blind free list hands out once it has
+ * been churned.
+ */
+
+#include <pmap.h>
+#include "bench.h"
+
+#define NCHURN		2048
+#define NROUND		100
+
+static struct Page *churn[NCHURN];
+static struct Page *set[PAGE_NCOLOR];
+
+static u_int seed = 1;
+
+static u_int
+rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+/* Overview:
+ *	Allocate NCHURN pages and free them again in random order, so the
+ *	free lists are no longer in address order.
+ */
+static void
+churn_free_lists(void)
+{
+	struct Page *p;
+	u_int i, j;
+
+	for (i = 0; i < NCHURN; i++) {
+		if (page_alloc(&churn[i]) < 0) {
+			panic("color_bench: out of memory");
+		}
+	}
+
+	for (i = NCHURN; i > 0; i--) {
+		j = rnd() % i;
+		p = churn[j];
+		churn[j] = churn[i - 1];
+		page_free(p);
+	}
+}
+
+/* Overview:
+ *	Allocate a working set of `n` pages for the addresses from UTEXT on,
+ *	by color or at random, and free it again.
+ *
+ * Post-Condition:
+ *	Return how many of its pages share a color with another one.
+ */
+static u_int
+conflicts(u_int n, int colored)
+{
+	u_int i, j, c = 0;
+
+	for (i = 0; i < n; i++) {
+		if (page_alloc_va(colored ? UTEXT + i * BY2PG : rnd() << PGSHIFT,
+						  &set[i]) < 0) {
+			panic("color_bench: out of memory");
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++) {
+			if (j != i && page2color(set[j]) == page2color(set[i])) {
+				c++;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		page_free(set[i]);
+	}
+
+	return c;
+}
+
+void
+color_bench(void)
+{
+	u_int n, round, colored, blind;
+
+	churn_free_lists();
+
+	for (n = 4; n <= PAGE_NCOLOR; n *= 2) {
+		colored = blind = 0;
+		for (round = 0; round < NROUND; round++) {
+			colored += conflicts(n, 1);
+			blind += conflicts(n, 0);
+		}
+		printf("%d-page set: %d%% of pages share a color, %d%% color-blind\n",
+			   n, colored * 100 / (n * NROUND), blind * 100 / (n * NROUND));
+	}
+
+	printf("color_bench: done\n");
+}
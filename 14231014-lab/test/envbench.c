@@ -0,0 +1,68 @@
+/*
+ * Env slot churn: the cost of env_alloc() when one slot is handed out
+ * over and over, and of envid2env() on live and stale envids:
+ *
+ *	make test_dir=test DEFS=-DFTEST=env_churn_bench
+ *
+ * Every envid handed out must be new, and every stale one must be
+ * refused.  Times are per call (see bench.h for what they mean).
+ */
+
+#include <env.h>
+#include "bench.h"
+
+#define NROUND		200
+#define NLOOKUP		1000
+
+static u_int ids[NROUND];
+
+void
+env_churn_bench(void)
+{
+	struct Env *e;
+	u_int round, i, t, alloc = 0, live, stale;
+
+	for (round = 0; round < NROUND; round++) {
+		t = kclock_usec();
+		if (env_alloc(&e, 0) < 0) {
+			panic("env_churn_bench: env_alloc failed");
+		}
+		alloc += kclock_usec() - t;
+
+		ids[round] = e->env_id;
+		for (i = 0; i < round; i++) {
+			if (ids[i] == e->env_id) {
+				panic("env_churn_bench: envid %x handed out twice", e->env_id);
+			}
+		}
+
+		if (round < NROUND - 1) {
+			env_free(e);
+		}
+	}
+
+	t = kclock_usec();
+	for (i = 0; i < NLOOKUP; i++) {
+		if (envid2env(ids[NROUND - 1], &e, 0) < 0) {
+			panic("env_churn_bench: live envid refused");
+		}
+	}
+	live = kclock_usec() - t;
+
+	t = kclock_usec();
+	for (i = 0; i < NLOOKUP; i++) {
+		if (envid2env(ids[i % (NROUND - 1)], &e, 0) == 0) {
+			panic("env_churn_bench: stale envid %x accepted",
+				  ids[i % (NROUND - 1)]);
+		}
+	}
+	stale = kclock_usec() - t;
+
+	env_free(&envs[ENVX(ids[NROUND - 1])]);
+
+	printf("env_alloc %d ns\tenvid2env live %d ns, stale %d ns\n",
+		   bench_ns(alloc, NROUND), bench_ns(live, NLOOKUP),
+		   bench_ns(stale, NLOOKUP));
+	printf("env_churn_bench: %d envids, all distinct, stale ones refused\n",
+		   NROUND);
+}
@@ -0,0 +1,71 @@
+/*
+ * env_create() latency and memory against program size, with the text
+ * shared from the kernel image, copied (the image is not page aligned)
+ * and loaded lazily:
+ *
+ *	make test_dir=test DEFS=-DFTEST=icode_bench
+ *
+ * Each program has a 16K data segment and a page of bss next to its
+ * text.  Memory is the number of free pages the new env took, page
+ * directory, tables, stack and info page included.
+ */
+
+#include <env.h>
+#include <pmap.h>
+#include "bench.h"
+
+#define NROUND		20
+#define DATA		(16 * 1024)
+
+/* Overview:
+ *	Create and free an env running `bin` NROUND times, the first time
+ *	untimed, so the page directory pool is warm.
+ *
+ * Post-Condition:
+ *	Return the time per create, in us, and set *npage to the pages the
+ *	env held before it was freed.
+ */
+static u_int
+time_create(u_char *bin, u_int size, int lazy, u_int *npage)
+{
+	u_int round, nfree, t, total = 0;
+
+	for (round = 0; round <= NROUND; round++) {
+		nfree = page_nfree;
+		t = kclock_usec();
+		if (lazy) {
+			env_create_lazy(bin, size);
+		} else {
+			env_create(bin, size);
+		}
+		t = kclock_usec() - t;
+		if (round > 0) {
+			total += t;
+		}
+		*npage = nfree - page_nfree;
+		env_free(bench_lone_env());
+	}
+
+	return total / NROUND;
+}
+
+void
+icode_bench(void)
+{
+	u_char *bin;
+	u_int text, size, shared, copied, lazy, ns, nc, nl;
+
+	for (text = 16 * 1024; text <= IMAGE_MAXTEXT; text *= 4) {
+		bin = bench_image(text, DATA, 0, &size);
+		shared = time_create(bin, size, 0, &ns);
+		lazy = time_create(bin, size, 1, &nl);
+		bin = bench_image(text, DATA, 1, &size);
+		copied = time_create(bin, size, 0, &nc);
+
+		printf("text %dK\tshared %d us, %d pages\tcopied %d us, %d pages"
+			   "\tlazy %d us, %d pages\n", text / 1024, shared, ns,
+			   copied, nc, lazy, nl);
+	}
+
+	printf("icode_bench: done\n");
+}
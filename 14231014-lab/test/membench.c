@@ -0,0 +1,107 @@
+/*
+ * Speed of the lib/memory.S routines next to the byte loops every copy
+ * and clear used to go through:
+ *
+ *	make test_dir=test DEFS=-DFTEST=mem_bench
+ *
+ * Each line moves NBYTE bytes in calls of one length and alignment and
+ * prints the time per KB (see bench.h for what the times mean).
+ */
+
+#include <mmu.h>
+#include "bench.h"
+
+#define NBYTE		(1 << 20)
+
+typedef void (*copy_fn)(const void *, void *, size_t);
+typedef void (*set_fn)(void *, size_t);
+
+static u_char src[2 * BY2PG] __attribute__((aligned(BY2PG)));
+static u_char dst[2 * BY2PG] __attribute__((aligned(BY2PG)));
+
+static void
+copy_bytes(const void *s, void *d, size_t len)
+{
+	const u_char *from = s;
+	u_char *to = d;
+
+	while (len-- > 0) {
+		*to++ = *from++;
+	}
+}
+
+static void
+copy_page(const void *s, void *d, size_t len)
+{
+	bcopy_page(s, d);
+}
+
+static void
+set_bytes(void *d, size_t len)
+{
+	u_char *to = d;
+
+	while (len-- > 0) {
+		*to++ = 0;
+	}
+}
+
+static void
+set_page(void *d, size_t len)
+{
+	bzero_page(d);
+}
+
+static void
+time_copy(const char *name, copy_fn fn, u_int soff, u_int doff, u_int len)
+{
+	u_int i, t;
+
+	t = kclock_usec();
+	for (i = 0; i < NBYTE / len; i++) {
+		fn(src + soff, dst + doff, len);
+	}
+	t = kclock_usec() - t;
+
+	printf("%s\t%d\tsrc+%d dst+%d\t%d ns/KB\n", name, len, soff, doff,
+		   bench_ns(t, NBYTE / 1024));
+}
+
+static void
+time_set(const char *name, set_fn fn, u_int doff, u_int len)
+{
+	u_int i, t;
+
+	t = kclock_usec();
+	for (i = 0; i < NBYTE / len; i++) {
+		fn(dst + doff, len);
+	}
+	t = kclock_usec() - t;
+
+	printf("%s\t%d\tdst+%d\t%d ns/KB\n", name, len, doff,
+		   bench_ns(t, NBYTE / 1024));
+}
+
+void
+mem_bench(void)
+{
+	static const u_int lens[] = { 16, 64, 256, BY2PG };
+	static const u_int offs[][2] = { { 0, 0 }, { 1, 1 }, { 0, 1 }, { 3, 2 } };
+	u_int i, j;
+
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		for (j = 0; j < sizeof(offs) / sizeof(offs[0]); j++) {
+			time_copy("bytes", copy_bytes, offs[j][0], offs[j][1], lens[i]);
+			time_copy("bcopy", bcopy, offs[j][0], offs[j][1], lens[i]);
+		}
+		for (j = 0; j < 2; j++) {
+			time_set("bytes", set_bytes, j, lens[i]);
+			time_set("bzero", bzero, j, lens[i]);
+		}
+	}
+
+	time_copy("bcopy_page", copy_page, 0, 0, BY2PG);
+	time_set("bzero_page", set_page, 0, BY2PG);
+
+	printf("mem_bench: done\n");
+}
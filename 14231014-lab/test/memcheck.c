@@ -0,0 +1,155 @@
+/*
+ * Conformance check for the lib/memory.S block routines.  They are R3000
+ * code, so the check runs in the kernel under GXemul rather than on the
+ * build host:
+ *
+ *	make test_dir=test DEFS=-DFTEST=mem_check
+ *
+ * Every source/destination alignment 0-7 is tried with every length up
+ * to MAXLEN, then random offsets and lengths up to a page.  Results are
+ * compared with byte loops, and the GUARD bytes on both sides of the
+ * destination must come through untouched.
+ */
+
+#include <mmu.h>
+#include <printf.h>
+
+#define MAXLEN		100
+#define GUARD		8
+#define NRANDOM		2000
+
+static u_char src[BY2PG] __attribute__((aligned(BY2PG)));
+static u_char dst[BY2PG] __attribute__((aligned(BY2PG)));
+static u_char ref[BY2PG];
+
+static u_int seed = 1;
+
+static u_int
+rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static void
+fill(u_char *b, u_int len)
+{
+	u_int i;
+
+	for (i = 0; i < len; i++) {
+		b[i] = rnd();
+	}
+}
+
+static void
+compare(const char *what, u_int soff, u_int doff, u_int len)
+{
+	u_int i;
+
+	for (i = 0; i < doff + len + GUARD; i++) {
+		if (dst[i] != ref[i]) {
+			panic("mem_check: %s src+%d dst+%d len %d: byte %d is %x, not %x",
+				  what, soff, doff, len, i, dst[i], ref[i]);
+		}
+	}
+}
+
+/*
+ * Only dst[0, doff + len + GUARD) is filled and compared; callers keep
+ * GUARD bytes free on both sides of the copy.
+ */
+static void
+check_copy(u_int soff, u_int doff, u_int len, int use_bcopy)
+{
+	u_int i;
+	void *ret = 0;
+
+	fill(src + soff, len);
+	fill(dst, doff + len + GUARD);
+	for (i = 0; i < doff + len + GUARD; i++) {
+		ref[i] = dst[i];
+	}
+	for (i = 0; i < len; i++) {
+		ref[doff + i] = src[soff + i];
+	}
+
+	if (use_bcopy) {
+		bcopy(src + soff, dst + doff, len);
+	} else {
+		ret = memcpy(dst + doff, src + soff, len);
+	}
+	compare(use_bcopy ? "bcopy" : "memcpy", soff, doff, len);
+	if (!use_bcopy && ret != dst + doff) {
+		panic("mem_check: memcpy returned %x, not %x", ret, dst + doff);
+	}
+}
+
+static void
+check_set(u_int doff, u_int len, int c, int use_bzero)
+{
+	u_int i;
+	void *ret = 0;
+
+	fill(dst, doff + len + GUARD);
+	for (i = 0; i < doff + len + GUARD; i++) {
+		ref[i] = dst[i];
+	}
+	for (i = 0; i < len; i++) {
+		ref[doff + i] = use_bzero ? 0 : (u_char)c;
+	}
+
+	if (use_bzero) {
+		bzero(dst + doff, len);
+	} else {
+		ret = memset(dst + doff, c, len);
+	}
+	compare(use_bzero ? "bzero" : "memset", 0, doff, len);
+	if (!use_bzero && ret != dst + doff) {
+		panic("mem_check: memset returned %x, not %x", ret, dst + doff);
+	}
+}
+
+void
+mem_check(void)
+{
+	u_int soff, doff, len, n;
+
+	for (soff = 0; soff < 8; soff++) {
+		for (doff = 0; doff < 8; doff++) {
+			for (len = 0; len <= MAXLEN; len++) {
+				check_copy(GUARD + soff, GUARD + doff, len, 0);
+				check_copy(GUARD + soff, GUARD + doff, len, 1);
+			}
+		}
+	}
+	for (doff = 0; doff < 8; doff++) {
+		for (len = 0; len <= MAXLEN; len++) {
+			check_set(GUARD + doff, len, 0, 1);
+			check_set(GUARD + doff, len, 0xa5, 0);
+			check_set(GUARD + doff, len, 0x1ff, 0);	/* only the low byte counts */
+		}
+	}
+
+	for (n = 0; n < NRANDOM; n++) {
+		len = rnd() % (BY2PG - 2 * GUARD);
+		soff = GUARD + rnd() % (BY2PG - 2 * GUARD - len + 1);
+		doff = GUARD + rnd() % (BY2PG - 2 * GUARD - len + 1);
+		check_copy(soff, doff, len, n & 1);
+		check_set(doff, len, rnd(), n & 1);
+	}
+
+	fill(src, BY2PG);
+	bcopy_page(src, dst);
+	for (n = 0; n < BY2PG; n++) {
+		ref[n] = src[n];
+	}
+	compare("bcopy_page", 0, 0, BY2PG - GUARD);
+
+	bzero_page(dst);
+	for (n = 0; n < BY2PG; n++) {
+		ref[n] = 0;
+	}
+	compare("bzero_page", 0, 0, BY2PG - GUARD);
+
+	printf("mem_check: ok\n");
+}
@@ -0,0 +1,57 @@
+/*
+ * env_create() latency with the page directory pool and without it:
+ *
+ *	make test_dir=test DEFS=-DFTEST=pgdir_pool_bench
+ *
+ * The program (see bench_image) has 16K of text and 16K of data.  Times
+ * are per env_create() (see bench.h for what they mean); env_free()
+ * is not timed.
+ */
+
+#include <env.h>
+#include "bench.h"
+
+#define NROUND		50
+#define TEXT		(16 * 1024)
+#define DATA		(16 * 1024)
+
+static u_int
+time_create(u_char *bin, u_int size)
+{
+	u_int round, t, total = 0;
+
+	for (round = 0; round < NROUND; round++) {
+		t = kclock_usec();
+		env_create(bin, size);
+		total += kclock_usec() - t;
+		env_free(bench_lone_env());
+	}
+
+	return total / NROUND;
+}
+
+void
+pgdir_pool_bench(void)
+{
+	u_char *bin;
+	u_int size, round, pooled, unpooled, hits;
+
+	bin = bench_image(TEXT, DATA, 0, &size);
+
+	hits = pgdir_pool_stat.hits;
+	pooled = time_create(bin, size);
+	hits = pgdir_pool_stat.hits - hits;
+
+	/* turn the pool off and drain it */
+	pgdir_pool_max = 0;
+	for (round = 0; round <= PGDIR_POOL_MAX; round++) {
+		env_create(bin, size);
+		env_free(bench_lone_env());
+	}
+	unpooled = time_create(bin, size);
+	pgdir_pool_max = PGDIR_POOL_MAX;
+
+	printf("env_create %d us with the pool (%d of %d hits), %d us without\n",
+		   pooled, hits, NROUND, unpooled);
+	printf("pgdir_pool_bench: done\n");
+}
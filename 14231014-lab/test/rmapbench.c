@@ -0,0 +1,117 @@
+/*
+ * Cost of unmapping a page shared by N envs: through its reverse map
+ * (page_unmap_all), and by scanning every env's page tables for it,
+ * which is what it took before pages had one:
+ *
+ *	make test_dir=test DEFS=-DFTEST=rmap_bench
+ *
+ * Each env gets the page at the same address.  Times are per unmap
+ * (see bench.h for what they mean).
+ */
+
+#include <env.h>
+#include <pmap.h>
+#include "bench.h"
+
+#define MAXSHARE	64
+#define NROUND		50
+#define VA		UTEXT
+
+static struct Env *sharer[MAXSHARE];
+
+/* Overview:
+ *	Remove every mapping of `pp` the slow way: look at each valid PTE
+ *	below UTOP of every env.
+ */
+static void
+unmap_by_scan(struct Page *pp)
+{
+	Pde *pgdir;
+	Pte *pt;
+	u_int i, pdeno, pteno;
+
+	for (i = 0; i < NENV; i++) {
+		if (envs[i].env_status == ENV_FREE) {
+			continue;
+		}
+		pgdir = envs[i].env_pgdir;
+
+		for (pdeno = 0; pdeno < PDX(UTOP); pdeno++) {
+			if (!(pgdir[pdeno] & PTE_V)) {
+				continue;
+			}
+			pt = (Pte *)KADDR(PTE_ADDR(pgdir[pdeno]));
+
+			/* page_remove() frees the table with its last entry */
+			for (pteno = 0; pteno <= PTX(~0) && (pgdir[pdeno] & PTE_V);
+				 pteno++) {
+				if ((pt[pteno] & PTE_V) &&
+					PTE_ADDR(pt[pteno]) == page2pa(pp)) {
+					page_remove(pgdir, (pdeno << 22) | (pteno << PGSHIFT));
+				}
+			}
+		}
+	}
+}
+
+/* Overview:
+ *	Map a fresh page at VA in the first `n` sharers and time removing
+ *	it from all of them, NROUND times.
+ *
+ * Post-Condition:
+ *	Return the time per unmap, in ns.
+ */
+static u_int
+time_unmap(u_int n, int scan)
+{
+	struct Page *p;
+	u_int i, round, t, total = 0;
+
+	for (round = 0; round < NROUND; round++) {
+		if (page_alloc(&p) < 0) {
+			panic("rmap_bench: out of memory");
+		}
+		for (i = 0; i < n; i++) {
+			if (page_insert(sharer[i]->env_pgdir, p, VA, PTE_V | PTE_R) < 0) {
+				panic("rmap_bench: out of memory");
+			}
+		}
+
+		t = kclock_usec();
+		if (scan) {
+			unmap_by_scan(p);
+		} else {
+			page_unmap_all(p);
+		}
+		total += kclock_usec() - t;
+
+		if (p->pp_ref != 0 || p->pp_rpgdir != 0) {
+			panic("rmap_bench: page still mapped");
+		}
+	}
+
+	return bench_ns(total, NROUND);
+}
+
+void
+rmap_bench(void)
+{
+	u_int i, n;
+
+	for (i = 0; i < MAXSHARE; i++) {
+		if (env_alloc(&sharer[i], 0) < 0) {
+			panic("rmap_bench: out of envs");
+		}
+	}
+
+	for (n = 1; n <= MAXSHARE; n *= 2) {
+		printf("%d sharers\tpage_unmap_all %d ns\tscan %d ns\n", n,
+			   time_unmap(n, 0), time_unmap(n, 1));
+	}
+
+	for (i = 0; i < MAXSHARE; i++) {
+		env_free(sharer[i]);
+	}
+
+	printf("rmap_bench: done\n");
+}
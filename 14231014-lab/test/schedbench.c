@@ -0,0 +1,52 @@
+/*
+ * Cost of the scheduler's scan for the next runnable env (sched_next)
+ * with 1 to 64 envs alive, averaged over every starting slot:
+ *
+ *	make test_dir=test DEFS=-DFTEST=sched_bench
+ *
+ * GXemul does not model cache timing, so the times (see bench.h) show
+ * only the instructions a scan runs.  What the hot/cold split of struct
+ * Env saves on real hardware is memory traffic, so the bytes a full
+ * scan sweeps are printed too, with and without the split.
+ */
+
+#include <env.h>
+#include <sched.h>
+#include "bench.h"
+
+#define MAXENV		64
+
+static struct Env *alive[MAXENV];
+
+void
+sched_bench(void)
+{
+	u_int n, k, start, t;
+
+	for (k = 0, n = 1; n <= MAXENV; n *= 8) {
+		for (; k < n; k++) {
+			if (env_alloc(&alive[k], 0) < 0) {
+				panic("sched_bench: out of envs");
+			}
+		}
+
+		t = kclock_usec();
+		for (start = 0; start < NENV; start++) {
+			if (sched_next(start) == 0) {
+				panic("sched_bench: no runnable env");
+			}
+		}
+		t = kclock_usec() - t;
+
+		printf("%d envs\t%d ns per scan\n", n, bench_ns(t, NENV));
+	}
+
+	while (k > 0) {
+		env_free(alive[--k]);
+	}
+
+	printf("a full scan sweeps %d bytes, about %d without the hot/cold split\n",
+		   NENV * sizeof(struct Env),
+		   NENV * (sizeof(struct Env) + sizeof(struct Env_cold)));
+	printf("sched_bench: done\n");
+}
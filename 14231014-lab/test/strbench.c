@@ -0,0 +1,108 @@
+/*
+ * Speed of the lib/string.c routines next to plain byte loops:
+ *
+ *	make test_dir=test DEFS=-DFTEST=str_bench
+ *
+ * Each line scans NBYTE bytes of strings of one length, starting at one
+ * alignment, and prints the time per KB (see bench.h for what the times
+ * mean).  strcmp and strncmp compare two equal strings, the worst case,
+ * and strchr looks for the terminating NUL.
+ */
+
+#include <mmu.h>
+#include <string.h>
+#include "bench.h"
+
+#define NBYTE		(1 << 20)
+#define MAXLEN		1024
+
+static char a[MAXLEN + 8] __attribute__((aligned(8)));
+static char b[MAXLEN + 8] __attribute__((aligned(8)));
+static char d[MAXLEN + 8] __attribute__((aligned(8)));
+
+/* keeps the compiler from dropping calls whose result is unused */
+static volatile int sink;
+
+static int
+len_bytes(const char *s)
+{
+	int n = 0;
+
+	while (*s++) {
+		n++;
+	}
+	return n;
+}
+
+static int
+cmp_bytes(const char *p, const char *q)
+{
+	while (*p && *p == *q) {
+		p++;
+		q++;
+	}
+	return (u_char)*p - (u_char)*q;
+}
+
+static char *
+cpy_bytes(char *dst, const char *src)
+{
+	char *ret = dst;
+
+	while ((*dst++ = *src++) != 0)
+		;
+	return ret;
+}
+
+/* Run one routine over every string of the round and return the
+ * time per KB. */
+static u_int
+run(int which, u_int off, u_int len)
+{
+	u_int i, t;
+
+	t = kclock_usec();
+	for (i = 0; i < NBYTE / len; i++) {
+		switch (which) {
+		case 0: sink = len_bytes(a + off); break;
+		case 1: sink = strlen(a + off); break;
+		case 2: sink = cmp_bytes(a + off, b + off); break;
+		case 3: sink = strcmp(a + off, b + off); break;
+		case 4: sink = strncmp(a + off, b + off, len + 1); break;
+		case 5: sink = (int)cpy_bytes(d + off, a + off); break;
+		case 6: sink = (int)strcpy(d + off, a + off); break;
+		case 7: sink = (int)strncpy(d + off, a + off, len + 1); break;
+		case 8: sink = (int)strchr(a + off, 0); break;
+		}
+	}
+	t = kclock_usec() - t;
+
+	return bench_ns(t, NBYTE / 1024);
+}
+
+void
+str_bench(void)
+{
+	static const char *names[] = {
+		"bytes strlen", "strlen", "bytes strcmp", "strcmp", "strncmp",
+		"bytes strcpy", "strcpy", "strncpy", "strchr",
+	};
+	static const u_int lens[] = { 8, 32, 128, MAXLEN };
+	u_int i, j, off;
+
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		for (off = 0; off < 4; off += 3) {
+			for (j = 0; j < lens[i]; j++) {
+				a[off + j] = b[off + j] = 'a' + j % 26;
+			}
+			a[off + j] = b[off + j] = 0;
+
+			for (j = 0; j < sizeof(names) / sizeof(names[0]); j++) {
+				printf("%s\t%d\t+%d\t%d ns/KB\n", names[j], lens[i], off,
+					   run(j, off, lens[i]));
+			}
+		}
+	}
+
+	printf("str_bench: done\n");
+}
@@ -0,0 +1,130 @@
+/*
+ * Reading a user buffer with copyin(), through the env's own mappings,
+ * against walking its page table and copying through KADDR, which is
+ * what the kernel did before lib/uaccess.S:
+ *
+ *	make test_dir=test DEFS=-DFTEST=uaccess_bench
+ *
+ * The buffer is NPAGE pages, all mapped, read at the sizes in `sizes'
+ * from the start of the buffer.  copyin() takes a TLB refill the first
+ * time it touches each page, so the TLB is flushed once before each
+ * timed loop only.  Times are per copy, rates in MB/s.
+ */
+
+#include <env.h>
+#include <pmap.h>
+#include <trap.h>
+#include <error.h>
+#include <uaccess.h>
+#include "bench.h"
+
+#define NROUND		1000
+#define NPAGE		4
+#define VA		0x10000000
+
+static u_int sizes[] = { 16, sizeof(struct Trapframe), BY2PG, NPAGE * BY2PG };
+static u_char buf[NPAGE * BY2PG];
+
+/* Overview:
+ *	Copy `n` bytes from `va` in `pgdir` to `dst` a page at a time,
+ *	finding each page with page_lookup().
+ *
+ * Post-Condition:
+ *	Return 0, or -E_INVAL if a page in the range is not mapped.
+ */
+static int
+walk_copyin(Pde *pgdir, void *dst, u_long va, u_int n)
+{
+	struct Page *p;
+	u_int len;
+
+	while (n > 0) {
+		if ((p = page_lookup(pgdir, va, 0)) == 0) {
+			return -E_INVAL;
+		}
+		len = MIN(n, BY2PG - (va & (BY2PG - 1)));
+		bcopy((void *)(page2kva(p) + (va & (BY2PG - 1))), dst, len);
+		dst = (u_char *)dst + len;
+		va += len;
+		n -= len;
+	}
+
+	return 0;
+}
+
+/* Overview:
+ *	Time NROUND reads of `n` bytes at VA, with copyin() or, if `walk`,
+ *	walk_copyin().
+ *
+ * Post-Condition:
+ *	Return the time per read, in ns.
+ */
+static u_int
+time_copyin(u_int n, int walk)
+{
+	u_int round, t;
+	int r;
+
+	tlb_flush_asid(curenv->env_asid);
+	t = kclock_usec();
+	for (round = 0; round < NROUND; round++) {
+		r = walk ? walk_copyin(curenv->env_pgdir, buf, VA, n)
+			: copyin(buf, VA, n);
+		if (r < 0) {
+			panic("uaccess_bench: copy failed");
+		}
+	}
+
+	return bench_ns(kclock_usec() - t, NROUND);
+}
+
+// MB/s, in tenths, for `n` bytes a read that took `ns`.
+static u_int
+rate(u_int n, u_int ns)
+{
+	return ns ? n * 10000 / 1024 * 1000 / 1024 / ns : 0;
+}
+
+void
+uaccess_bench(void)
+{
+	struct Env *e;
+	struct Page *p;
+	u_int i, n, in, walk;
+
+	if (env_alloc(&e, 0) < 0) {
+		panic("uaccess_bench: out of envs");
+	}
+	for (i = 0; i < NPAGE; i++) {
+		if (page_alloc(&p) < 0 ||
+			page_insert(e->env_pgdir, p, VA + i * BY2PG, PTE_V | PTE_R) < 0) {
+			panic("uaccess_bench: out of memory");
+		}
+	}
+
+	/* copyin() goes through the TLB under the ASID in EntryHi, which
+	 * nothing has changed from 0 since reset; traps must be on for the
+	 * refills it takes */
+	if (e->env_asid != 0) {
+		panic("uaccess_bench: env %x is not on ASID 0", e->env_id);
+	}
+	trap_init();
+	curenv = e;
+	mCONTEXT = (u_long)e->env_pgdir;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		n = sizes[i];
+		in = time_copyin(n, 0);
+		walk = time_copyin(n, 1);
+		printf("%d bytes\tcopyin %d ns, %d.%d MB/s\t"
+			   "page walk %d ns, %d.%d MB/s\n", n,
+			   in, rate(n, in) / 10, rate(n, in) % 10,
+			   walk, rate(n, walk) / 10, rate(n, walk) % 10);
+	}
+
+	curenv = NULL;
+	mCONTEXT = 0;
+	env_free(e);
+
+	printf("uaccess_bench: done\n");
+}
@@ -0,0 +1,246 @@
+/*
+ * mkinitrd: pack user programs into the initrd archive the kernel links
+ * in (see include/initrd.h).  Runs on the build host.
+ *
+ *	mkinitrd out.img [-z | -n] prog ...
+ *
+ * Each program is stored under its file name without directories.
+ * After -z, programs are LZSS compressed (kept as is if that does not
+ * make them smaller); -n switches compression off again.
+ *
+ * The archive is written in host byte order, which must match the
+ * target's (little-endian).
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITRD_HOST
+#include "../include/initrd.h"
+
+struct prog {
+	const char *name;
+	unsigned char *data;		/* bytes to store */
+	unsigned int size;
+	unsigned int rawsize;
+	unsigned int flags;
+};
+
+static struct prog progs[INITRD_MAXENT];
+static unsigned int nprog;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "mkinitrd: ");
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	exit(1);
+}
+
+static unsigned char *
+read_file(const char *path, unsigned int *size)
+{
+	FILE *f;
+	unsigned char *buf;
+	long n;
+
+	if ((f = fopen(path, "rb")) == NULL) {
+		die("cannot open %s", path);
+	}
+	fseek(f, 0, SEEK_END);
+	n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if ((buf = malloc(n ? n : 1)) == NULL || fread(buf, 1, n, f) != (size_t)n) {
+		die("cannot read %s", path);
+	}
+	fclose(f);
+
+	*size = n;
+	return buf;
+}
+
+/*
+ * Greedy LZSS in the format initrd_inflate() reads: a flag byte per
+ * eight items, set bits for literals, clear bits for two-byte matches.
+ * Returns the compressed size, or 0 if it would not fit in `max`.
+ */
+static unsigned int
+lzss(const unsigned char *in, unsigned int n, unsigned char *out, unsigned int max)
+{
+	unsigned int i = 0, o = 0, fpos = 0, bit = 8;
+	unsigned int j, k, best, boff, lim;
+
+	while (i < n) {
+		if (bit == 8) {
+			if (o >= max) {
+				return 0;
+			}
+			fpos = o++;
+			out[fpos] = 0;
+			bit = 0;
+		}
+
+		best = 0;
+		boff = 0;
+		lim = n - i < INITRD_LZ_MAX ? n - i : INITRD_LZ_MAX;
+		for (j = i > INITRD_LZ_WINDOW ? i - INITRD_LZ_WINDOW : 0; j < i; j++) {
+			for (k = 0; k < lim && in[j + k] == in[i + k]; k++)
+				;
+			if (k > best) {
+				best = k;
+				boff = i - j;
+			}
+		}
+
+		if (best >= INITRD_LZ_MIN) {
+			if (o + 2 > max) {
+				return 0;
+			}
+			out[o++] = (boff - 1) & 0xff;
+			out[o++] = ((boff - 1) >> 4 & 0xf0) | (best - INITRD_LZ_MIN);
+			i += best;
+		} else {
+			if (o >= max) {
+				return 0;
+			}
+			out[fpos] |= 1 << bit;
+			out[o++] = in[i++];
+		}
+		bit++;
+	}
+
+	return o;
+}
+
+static void
+add_prog(const char *path, int compress)
+{
+	struct prog *p;
+	const char *slash;
+	unsigned char *z;
+	unsigned int zn;
+	unsigned int i;
+
+	if (nprog == INITRD_MAXENT) {
+		die("more than %d programs", INITRD_MAXENT);
+	}
+	p = &progs[nprog++];
+	p->name = (slash = strrchr(path, '/')) ? slash + 1 : path;
+
+	if (strlen(p->name) >= INITRD_NAMELEN) {
+		die("name too long: %s", p->name);
+	}
+	for (i = 0; i < nprog - 1; i++) {
+		if (strcmp(progs[i].name, p->name) == 0) {
+			die("duplicate name: %s", p->name);
+		}
+	}
+
+	p->data = read_file(path, &p->size);
+	p->rawsize = p->size;
+	p->flags = 0;
+
+	if (compress && p->size) {
+		if ((z = malloc(p->size)) == NULL) {
+			die("out of memory compressing %s", path);
+		}
+		if ((zn = lzss(p->data, p->size, z, p->size - 1)) != 0) {
+			free(p->data);
+			p->data = z;
+			p->size = zn;
+			p->flags = INITRD_Z;
+		} else {
+			free(z);
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	struct Initrd_hdr h;
+	struct Initrd_ent *ents;
+	unsigned int *bucket;
+	unsigned int i, b, off;
+	unsigned char *img;
+	int compress = 0;
+	FILE *f;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: mkinitrd out.img [-z | -n] prog ...\n");
+		return 1;
+	}
+
+	for (i = 2; i < (unsigned int)argc; i++) {
+		if (strcmp(argv[i], "-z") == 0) {
+			compress = 1;
+		} else if (strcmp(argv[i], "-n") == 0) {
+			compress = 0;
+		} else {
+			add_prog(argv[i], compress);
+		}
+	}
+
+	/* about two buckets per program keeps chains at one entry */
+	h.ih_magic = INITRD_MAGIC;
+	h.ih_nent = nprog;
+	for (h.ih_nbucket = 1; h.ih_nbucket < 2 * nprog; h.ih_nbucket <<= 1)
+		;
+
+	off = sizeof(h) + h.ih_nbucket * sizeof(*bucket) + nprog * sizeof(*ents);
+	bucket = malloc(h.ih_nbucket * sizeof(*bucket));
+	ents = calloc(nprog ? nprog : 1, sizeof(*ents));
+	if (bucket == NULL || ents == NULL) {
+		die("out of memory");
+	}
+	memset(bucket, 0xff, h.ih_nbucket * sizeof(*bucket));
+
+	for (i = 0; i < nprog; i++) {
+		off = (off + INITRD_ALIGN - 1) & ~(INITRD_ALIGN - 1);
+		strcpy(ents[i].ie_name, progs[i].name);
+		ents[i].ie_hash = initrd_hash(progs[i].name);
+		ents[i].ie_off = off;
+		ents[i].ie_size = progs[i].size;
+		ents[i].ie_rawsize = progs[i].rawsize;
+		ents[i].ie_flags = progs[i].flags;
+
+		b = ents[i].ie_hash & (h.ih_nbucket - 1);
+		ents[i].ie_next = bucket[b];
+		bucket[b] = i;
+
+		off += progs[i].size;
+	}
+	h.ih_size = off;
+
+	if ((img = calloc(1, off)) == NULL) {
+		die("out of memory");
+	}
+	off = 0;
+	memcpy(img, &h, sizeof(h));
+	off += sizeof(h);
+	memcpy(img + off, bucket, h.ih_nbucket * sizeof(*bucket));
+	off += h.ih_nbucket * sizeof(*bucket);
+	memcpy(img + off, ents, nprog * sizeof(*ents));
+	for (i = 0; i < nprog; i++) {
+		memcpy(img + ents[i].ie_off, progs[i].data, progs[i].size);
+	}
+
+	if ((f = fopen(argv[1], "wb")) == NULL ||
+		fwrite(img, 1, h.ih_size, f) != h.ih_size || fclose(f) != 0) {
+		die("cannot write %s", argv[1]);
+	}
+
+	for (i = 0; i < nprog; i++) {
+		printf("%-31s %8u -> %8u\n", progs[i].name, progs[i].rawsize, progs[i].size);
+	}
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * strcheck: check the kernel string routines (lib/string.c) against the
+ * host C library.  Runs on the build host; see the `check' target in the
+ * top Makefile, which builds lib/string.c with every routine renamed to
+ * k_<name>.
+ *
+ *	strcheck [iterations]
+ *
+ * Each iteration builds random strings at random alignments, often with
+ * a shared prefix and bytes above 0x7f, and compares results, return
+ * values and the bytes around every destination.  The strlen and strchr
+ * strings also end right before an unmapped page, so a word read past
+ * the page would fault.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MAXLEN		80
+#define GUARD		8
+
+int k_strlen(const char *s);
+int k_strcmp(const char *p, const char *q);
+int k_strncmp(const char *p, const char *q, unsigned int n);
+char *k_strcpy(char *dst, const char *src);
+char *k_strncpy(char *dst, const char *src, unsigned int n);
+const char *k_strchr(const char *s, int c);
+
+static unsigned long iter;
+
+static void
+die(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fprintf(stderr, "strcheck: iteration %lu: ", iter);
+	vfprintf(stderr, fmt, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	exit(1);
+}
+
+static int
+sign(int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+/* A random string of len bytes plus terminator; mostly a small alphabet
+ * so that comparisons run into long common prefixes. */
+static void
+rand_string(char *s, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (rand() % 8 == 0) {
+			s[i] = 1 + rand() % 255;
+		} else {
+			s[i] = 'a' + rand() % 3;
+		}
+	}
+	s[len] = 0;
+}
+
+static void
+check_strlen_strchr(char *edge)
+{
+	int len = rand() % MAXLEN;
+	char *s = edge - len - 1;
+	int c, i;
+
+	rand_string(s, len);
+	if (k_strlen(s) != (int)strlen(s)) {
+		die("strlen(len %d) = %d", len, k_strlen(s));
+	}
+	for (i = 0; i < 4; i++) {
+		c = i == 0 ? 0 : i == 1 && len > 0 ? s[rand() % len] : rand() % 256;
+		if (k_strchr(s, c) != strchr(s, c)) {
+			die("strchr(len %d, %#x) is off", len, c);
+		}
+	}
+}
+
+static void
+check_strcmp(void)
+{
+	char a[MAXLEN + 8], b[MAXLEN + 8];
+	char *p = a + rand() % 8, *q = b + rand() % 8;
+	int len = rand() % MAXLEN;
+	int n, r;
+
+	rand_string(p, len);
+	if (rand() % 2) {
+		strcpy(q, p);
+		if (len > 0 && rand() % 2) {
+			q[rand() % len] = 1 + rand() % 255;
+		}
+		if (rand() % 4 == 0) {
+			q[rand() % (len + 1)] = 0;
+		}
+	} else {
+		rand_string(q, rand() % MAXLEN);
+	}
+
+	r = k_strcmp(p, q);
+	if (sign(r) != sign(strcmp(p, q))) {
+		die("strcmp = %d, host %d", r, strcmp(p, q));
+	}
+	n = rand() % (MAXLEN + 8);
+	r = k_strncmp(p, q, n);
+	if (sign(r) != sign(strncmp(p, q, n))) {
+		die("strncmp(%d) = %d, host %d", n, r, strncmp(p, q, n));
+	}
+}
+
+static void
+check_strcpy(void)
+{
+	char src[MAXLEN + 8];
+	char dst[MAXLEN + 2 * GUARD + 8], ref[sizeof(dst)];
+	char *s = src + rand() % 8;
+	int doff = GUARD + rand() % 8;
+	int len = rand() % MAXLEN;
+	int n = rand() % (MAXLEN + 1);
+
+	rand_string(s, len);
+
+	memset(dst, 0x5a, sizeof(dst));
+	memset(ref, 0x5a, sizeof(ref));
+	if (k_strcpy(dst + doff, s) != dst + doff) {
+		die("strcpy return value");
+	}
+	strcpy(ref + doff, s);
+	if (memcmp(dst, ref, sizeof(dst)) != 0) {
+		die("strcpy(len %d, dst+%d)", len, doff);
+	}
+
+	if (doff + n + GUARD > (int)sizeof(dst)) {
+		n = sizeof(dst) - doff - GUARD;
+	}
+	memset(dst, 0x5a, sizeof(dst));
+	memset(ref, 0x5a, sizeof(ref));
+	if (k_strncpy(dst + doff, s, n) != dst + doff) {
+		die("strncpy return value");
+	}
+	strncpy(ref + doff, s, n);
+	if (memcmp(dst, ref, sizeof(dst)) != 0) {
+		die("strncpy(len %d, dst+%d, n %d)", len, doff, n);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned long n = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000000;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	char *pages;
+
+	pages = mmap(NULL, 2 * pagesize, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pages == MAP_FAILED || mprotect(pages + pagesize, pagesize, PROT_NONE) < 0) {
+		perror("strcheck: mmap");
+		return 1;
+	}
+	srand(1);
+
+	for (iter = 0; iter < n; iter++) {
+		check_strlen_strchr(pages + pagesize - rand() % 4);
+		check_strcmp();
+		check_strcpy();
+	}
+
+	printf("strcheck: %lu iterations ok\n", n);
+	return 0;
+}
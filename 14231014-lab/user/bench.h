@@ -0,0 +1,43 @@
+/*
+ * Shared bits of the user benchmarks in this directory.  Each one is a
+ * program of its own, run under GXemul from the initrd, e.g.
+ *
+ *	make initrd_progs=user/nullbench.b DEFS='-DPNAME=\"nullbench.b\"'
+ *
+ * and timed with uinfo_time_ms(), that is, to a clock tick (5 ms), so
+ * each loop runs long enough for that not to matter.  As with the
+ * kernel benchmarks (test/bench.h), the numbers only compare the
+ * variants one benchmark runs side by side on the same host.
+ */
+
+#ifndef _USER_BENCH_H_
+#define _USER_BENCH_H_
+
+#include "lib.h"
+
+/* Overview:
+ *	Wait for the next clock tick, so a timed loop starts on one.
+ *
+ * Post-Condition:
+ *	Return uinfo_time_ms() at that tick.
+ */
+static inline u_int
+bench_start(void)
+{
+	u_int t = uinfo_ticks();
+
+	while (uinfo_ticks() == t)
+		;
+	return uinfo_time_ms();
+}
+
+// Nanoseconds per item, for `n` items (n < 4M) that took `ms`.
+static inline u_int
+bench_ns(u_int ms, u_int n)
+{
+	u_int usec = ms * 1000;
+
+	return usec / n * 1000 + usec % n * 1000 / n;
+}
+
+#endif /* _USER_BENCH_H_ */
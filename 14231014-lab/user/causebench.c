@@ -0,0 +1,131 @@
+/*
+ * The cost of an exception, per cause and entry stub (lib/genex.S):
+ *
+ *	make initrd_progs=user/causebench.b DEFS='-DPNAME=\"causebench.b\"'
+ *
+ * Each cause is timed on a loop that takes it once per round, less
+ * the same loop without it:
+ *
+ *	syscall		sys_getenvid(), on the fast path of handle_sys
+ *	refill		a load from a mapped page not in the TLB (handle_tlb),
+ *			less a load that hits
+ *	demand zero	a load from an unmapped page (handle_tlb, then
+ *			trap() and pageout()), less the sys_mem_unmap()
+ *			that unmaps it first
+ *	cow, sole	a write to a copy-on-write page with no other user
+ *			(handle_mod, trap(), page_cow_fault()), less the
+ *			sys_mem_map() that makes it copy-on-write again
+ *	cow, copy	the same for a page shared with a second mapping,
+ *			which is copied
+ *
+ * The TLB Mod and demand-zero numbers include the refill that precedes
+ * them, since remapping a page drops its TLB entry.  Breakpoints are
+ * left out: trap() prints a line for each.  Interrupts cannot be raised
+ * at will.
+ */
+
+#include "bench.h"
+
+#define NROUND		(16 * 1024)
+#define NPAGE		256		/* four times the TLB */
+#define ARENA		0x10000000
+#define COWVA		(ARENA + NPAGE * BY2PG)
+#define COWVA2		(COWVA + BY2PG)
+
+static volatile u_int sink;
+
+static inline u_int
+load(u_long va)
+{
+	return *(volatile u_int *)va;
+}
+
+static inline void
+store(u_long va, u_int v)
+{
+	*(volatile u_int *)va = v;
+}
+
+// Nanoseconds per round of a loop that started at `t`.
+static int
+lap(u_int t)
+{
+	return bench_ns(uinfo_time_ms() - t, NROUND);
+}
+
+void
+umain(void)
+{
+	int sys, hit, miss, unmap, zero, remap, sole, remap2, copy;
+	u_int i, t;
+
+	for (i = 0; i < NPAGE; i++) {
+		store(ARENA + i * BY2PG, i);
+	}
+	store(COWVA, 0);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_getenvid();
+	}
+	sys = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		sink = load(ARENA);
+	}
+	hit = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		sink = load(ARENA + (i % NPAGE) * BY2PG);
+	}
+	miss = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_unmap(0, COWVA2);
+	}
+	unmap = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_unmap(0, COWVA2);
+		sink = load(COWVA2);
+	}
+	zero = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_map(0, COWVA, 0, COWVA, PTE_V | PTE_COW);
+	}
+	remap = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_map(0, COWVA, 0, COWVA, PTE_V | PTE_COW);
+		store(COWVA, i);
+	}
+	sole = lap(t);
+
+	/* COWVA2 keeps the old page, so each write copies it */
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_map(0, COWVA, 0, COWVA2, PTE_V | PTE_COW);
+		syscall_mem_map(0, COWVA2, 0, COWVA, PTE_V | PTE_COW);
+	}
+	remap2 = lap(t);
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_map(0, COWVA, 0, COWVA2, PTE_V | PTE_COW);
+		syscall_mem_map(0, COWVA2, 0, COWVA, PTE_V | PTE_COW);
+		store(COWVA, i);
+	}
+	copy = lap(t);
+
+	writef("syscall %d ns\trefill %d ns\tdemand zero %d ns\n",
+		   sys, miss - hit, zero - unmap);
+	writef("cow, sole %d ns\tcow, copy %d ns\n", sole - remap, copy - remap2);
+	writef("causebench: done\n");
+}
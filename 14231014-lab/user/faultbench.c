@@ -0,0 +1,119 @@
+/*
+ * Write faults handled in the kernel and through the user page fault
+ * handler (pgfault_upcall):
+ *
+ *	make initrd_progs=user/faultbench.b DEFS='-DPNAME=\"faultbench.b\"'
+ *
+ * Copy-on-write pages are the kernel's (page_cow_fault()); only writes
+ * to plainly read-only pages reach the handler.  So the user-level
+ * copy-on-write here marks its pages read-only, not PTE_COW:
+ *
+ *	upcall		a fault whose handler only steps past the store:
+ *			trap() to the handler and back through UXRET, less
+ *			the same store to a writable page
+ *	cow, kernel	a write to a copy-on-write page shared with a
+ *			second mapping, which page_cow_fault() copies
+ *	cow, user	the same with a read-only page, which the handler
+ *			copies with sys_mem_alloc(), bcopy(), sys_mem_map()
+ *			and sys_mem_unmap()
+ *
+ * Both copy-on-write times are less the two sys_mem_map()s per round
+ * that share the page again.
+ */
+
+#include "bench.h"
+
+#define NROUND		(4 * 1024)
+#define VA		0x10000000
+#define VA2		(VA + BY2PG)
+#define PFTEMP		(UTEXT - 2 * BY2PG)
+
+/* a store the compiler cannot put in a branch delay slot, where the
+ * handler could not just step past it */
+static inline void
+poke(u_long va)
+{
+	asm volatile(".set noreorder\n\tsw $0, 0(%0)\n\tnop\n\t.set reorder"
+				 : : "r"(va) : "memory");
+}
+
+static void
+skip(struct Uxframe *uf)
+{
+	uf->uf_epc += 4;
+}
+
+static void
+copy(struct Uxframe *uf)
+{
+	u_long va = ROUNDDOWN(uf->uf_badvaddr, BY2PG);
+	int r;
+
+	if ((r = syscall_mem_alloc(0, PFTEMP, PTE_V | PTE_R)) < 0) {
+		user_panic("copy: %d", r);
+	}
+	bcopy((void *)va, (void *)PFTEMP, BY2PG);
+	if ((r = syscall_mem_map(0, PFTEMP, 0, va, PTE_V | PTE_R)) < 0) {
+		user_panic("copy: %d", r);
+	}
+	syscall_mem_unmap(0, PFTEMP);
+}
+
+// ns per round of a loop that started at `t`
+static int
+lap(u_int t)
+{
+	return bench_ns(uinfo_time_ms() - t, NROUND);
+}
+
+// time NROUND rounds of sharing VA with VA2 again, with `perm`, and of
+// writing to VA too if `write`
+static int
+reshare(u_int perm, int write)
+{
+	u_int i, t;
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		syscall_mem_map(0, VA, 0, VA2, perm);
+		syscall_mem_map(0, VA2, 0, VA, perm);
+		if (write) {
+			poke(VA);
+		}
+	}
+
+	return lap(t);
+}
+
+void
+umain(void)
+{
+	int store, upcall, remap, kernel, user;
+	u_int i, t;
+
+	*(volatile u_int *)VA = 0;
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		poke(VA);
+	}
+	store = lap(t);
+
+	set_pgfault_handler(skip);
+	syscall_mem_map(0, VA, 0, VA, PTE_V);
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		poke(VA);
+	}
+	upcall = lap(t);
+
+	remap = reshare(PTE_V | PTE_COW, 0);
+	kernel = reshare(PTE_V | PTE_COW, 1);
+
+	set_pgfault_handler(copy);
+	user = reshare(PTE_V, 1);
+
+	writef("upcall %d ns\tcow, kernel %d ns\tcow, user %d ns\n",
+		   upcall - store, kernel - remap, user - remap);
+	writef("faultbench: done\n");
+}
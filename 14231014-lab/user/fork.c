@@ -0,0 +1,79 @@
+#include "lib.h"
+#include <uvpt.h>
+
+struct Fork_stat fork_stat;
+
+// Run the syscalls queued on the batch page (see batch_flush).
+static void
+flush(void)
+{
+	int r;
+
+	if ((r = batch_flush()) < 0) {
+		user_panic("fork: %d", r);
+	}
+	fork_stat.traps++;
+}
+
+/* Overview:
+ *	Make env `child` a copy-on-write copy of the caller below
+ *	USTACKTOP: find the mapped pages through UVPT and queue the
+ *	sys_mem_map()s for each (uvpt_dup) on the batch page, running
+ *	them each time it fills up and once more at the end, together
+ *	with making the child runnable.
+ */
+static void
+duppages(u_int child)
+{
+	u_long va;
+	int n;
+
+	for (va = uvpt_next(0, USTACKTOP); va < USTACKTOP;
+		 va = uvpt_next(va + BY2PG, USTACKTOP)) {
+		while ((n = uvpt_dup(batch, child, va)) < 0) {
+			flush();
+		}
+		fork_stat.calls += n;
+	}
+
+	while (batch_queue(batch, SYS_set_env_status, child, ENV_RUNNABLE,
+					   0, 0, 0) == 0) {
+		flush();
+	}
+	fork_stat.calls++;
+	flush();
+}
+
+/* Overview:
+ *	Create a child that shares the caller's memory copy-on-write, and
+ *	resumes from here too.  It gets nothing of the batch page, the
+ *	info page (it has its own), the exception stack or any rings.
+ *
+ *	Only mapped pages are passed on, so an env loaded lazily
+ *	(env_create_lazy) must have touched all of its image first.
+ *
+ * Post-Condition:
+ *	Return the child's envid to the caller and 0 to the child.  Any
+ *	failure is fatal.
+ */
+int
+fork(void)
+{
+	int child;
+
+	batch_init();
+
+	if ((child = syscall_env_alloc()) < 0) {
+		user_panic("fork: %d", child);
+	}
+	if (child == 0) {
+		batch = 0;
+		return 0;
+	}
+
+	fork_stat.forks++;
+	fork_stat.traps++;
+	fork_stat.calls++;
+	duppages(child);
+	return child;
+}
@@ -0,0 +1,209 @@
+/*
+ * fork() with and without UVPT, and with and without the batch page:
+ *
+ *	make initrd_progs=user/forkbench.b DEFS='-DPNAME=\"forkbench.b\"'
+ *
+ * "uvpt" is the library fork(), which reads its page tables through
+ * UVPT and asks the kernel only to remap the pages it finds, running
+ * those syscalls 64 to a trap on the batch page.  "unbatched" finds
+ * the same pages the same way but makes each syscall a trap of its
+ * own.  "probe" is what a fork must do without UVPT: try the same two
+ * sys_mem_map()s on every page that might be mapped, failing on the
+ * others, batched like "uvpt".  It is even told where to look (the
+ * program's image, its data arena and the page table of its stack),
+ * which a real one would not know.
+ *
+ * The program dirties 16, 64 and 256 pages before forking.  Times,
+ * syscalls and traps are per fork; each child parks for good, so its
+ * exit does not count.
+ */
+
+#include "bench.h"
+#include <uvpt.h>
+
+#define NROUND		16
+#define ARENA		0x10000000
+#define MAXPAGE		256
+
+extern char end[];
+
+// Page ranges probe_fork() tries.
+static struct {
+	u_long lo;
+	u_long hi;
+} probe_range[] = {
+	{ UTEXT, 0 },
+	{ ARENA, ARENA + MAXPAGE * BY2PG },
+	{ USTACKTOP - PDMAP, USTACKTOP },
+};
+
+static u_int probe_calls, probe_traps, unbatched_traps;
+
+static void
+park(void)
+{
+	syscall_set_env_status(0, ENV_NOT_RUNNABLE);
+	syscall_yield();
+	user_panic("parked child ran");
+}
+
+static void
+probe_flush(void)
+{
+	/* the failed probes are the point: no error checking */
+	syscall_batch_enter();
+	probe_traps++;
+}
+
+/* Overview:
+ *	Run the syscalls queued on the batch page one trap each, as if
+ *	there were no batch page.
+ */
+static void
+run_unbatched(void)
+{
+	struct Batch_ent *be;
+
+	for (; batch->b_head != batch->b_tail; batch->b_head++) {
+		be = &batch->b_ent[batch->b_head & (BATCH_NENT - 1)];
+		be->be_ret = msyscall(be->be_sysno, be->be_arg[0], be->be_arg[1],
+							  be->be_arg[2], be->be_arg[3], be->be_arg[4]);
+		if (be->be_ret < 0) {
+			user_panic("unbatched_fork: %d", be->be_ret);
+		}
+		unbatched_traps++;
+	}
+}
+
+static int
+unbatched_fork(void)
+{
+	u_long va;
+	int child;
+
+	batch_init();
+
+	if ((child = syscall_env_alloc()) < 0) {
+		user_panic("unbatched_fork: %d", child);
+	}
+	if (child == 0) {
+		batch = 0;
+		return 0;
+	}
+	unbatched_traps++;
+
+	for (va = uvpt_next(0, USTACKTOP); va < USTACKTOP;
+		 va = uvpt_next(va + BY2PG, USTACKTOP)) {
+		uvpt_dup(batch, child, va);
+		run_unbatched();
+	}
+
+	batch_queue(batch, SYS_set_env_status, child, ENV_RUNNABLE, 0, 0, 0);
+	run_unbatched();
+	return child;
+}
+
+static int
+probe_fork(void)
+{
+	u_long va;
+	u_int i;
+	int child;
+
+	batch_init();
+
+	if ((child = syscall_env_alloc()) < 0) {
+		user_panic("probe_fork: %d", child);
+	}
+	if (child == 0) {
+		batch = 0;
+		return 0;
+	}
+	probe_calls++;
+	probe_traps++;
+
+	for (i = 0; i < sizeof(probe_range) / sizeof(probe_range[0]); i++) {
+		for (va = probe_range[i].lo; va < probe_range[i].hi; va += BY2PG) {
+			if (va == UINFO || va == BATCHVA) {
+				continue;
+			}
+			if (batch->b_tail - batch->b_head > BATCH_NENT - 2) {
+				probe_flush();
+			}
+			batch_queue(batch, SYS_mem_map, 0, va, child, va,
+						PTE_V | PTE_COW);
+			batch_queue(batch, SYS_mem_map, 0, va, 0, va, PTE_V | PTE_COW);
+			probe_calls += 2;
+		}
+	}
+
+	if (batch->b_tail - batch->b_head == BATCH_NENT) {
+		probe_flush();
+	}
+	batch_queue(batch, SYS_set_env_status, child, ENV_RUNNABLE, 0, 0, 0);
+	probe_calls++;
+	probe_flush();
+	return child;
+}
+
+// Microseconds per fork, for NROUND that took `ms`.
+static u_int
+per_fork(u_int ms)
+{
+	return ms * 1000 / NROUND;
+}
+
+void
+umain(void)
+{
+	struct Fork_stat fs;
+	u_int npage, i, t, uvpt, unbatched, probe;
+
+	probe_range[0].hi = ROUND((u_long)end, BY2PG);
+
+	for (npage = 16; npage <= MAXPAGE; npage *= 4) {
+		for (i = 0; i < npage; i++) {
+			*(volatile u_int *)(ARENA + i * BY2PG) = i;
+		}
+
+		fs = fork_stat;
+		t = bench_start();
+		for (i = 0; i < NROUND; i++) {
+			if (fork() == 0) {
+				park();
+			}
+		}
+		uvpt = uinfo_time_ms() - t;
+		fs.calls = fork_stat.calls - fs.calls;
+		fs.traps = fork_stat.traps - fs.traps;
+
+		unbatched_traps = 0;
+		t = bench_start();
+		for (i = 0; i < NROUND; i++) {
+			if (unbatched_fork() == 0) {
+				park();
+			}
+		}
+		unbatched = uinfo_time_ms() - t;
+
+		probe_calls = probe_traps = 0;
+		t = bench_start();
+		for (i = 0; i < NROUND; i++) {
+			if (probe_fork() == 0) {
+				park();
+			}
+		}
+		probe = uinfo_time_ms() - t;
+
+		writef("fork, %d pages: uvpt %d us, %d syscalls in %d traps "
+			   "(%d saved)\n", npage, per_fork(uvpt), fs.calls / NROUND,
+			   fs.traps / NROUND, (fs.calls - fs.traps) / NROUND);
+		writef("fork, %d pages: unbatched %d us, %d traps\n", npage,
+			   per_fork(unbatched), unbatched_traps / NROUND);
+		writef("fork, %d pages: probe %d us, %d syscalls in %d traps\n",
+			   npage, per_fork(probe), probe_calls / NROUND,
+			   probe_traps / NROUND);
+	}
+
+	writef("forkbench: done\n");
+}
@@ -0,0 +1,48 @@
+#include "lib.h"
+
+/* Overview:
+ *	Send `val`, and the page at `srcva` if it is not 0, to `whom`,
+ *	handing it the CPU (sys_ipc_send); yield while it is not receiving.
+ *	Any other error is fatal.
+ */
+void
+ipc_send(u_int whom, u_int val, u_int srcva, u_int perm)
+{
+	int r;
+
+	while ((r = syscall_ipc_send(whom, val, srcva, perm)) == -E_IPC_NOT_RECV) {
+		syscall_yield();
+	}
+
+	if (r < 0) {
+		user_panic("ipc_send: %d", r);
+	}
+}
+
+/* Overview:
+ *	Wait for a message, with a page mapped at `dstva` if the sender
+ *	sends one.  `whom` and `perm` may be 0.
+ *
+ * Post-Condition:
+ *	Return the value sent and set *whom and *perm to the sender and
+ *	the permissions of the page (0 if there was none).
+ */
+u_int
+ipc_recv(u_int *whom, u_int dstva, u_int *perm)
+{
+	struct Ipc_msg m;
+	int r;
+
+	if ((r = syscall_ipc_recv(dstva, 1, &m)) < 0) {
+		user_panic("ipc_recv: %d", r);
+	}
+
+	if (whom) {
+		*whom = m.im_from;
+	}
+	if (perm) {
+		*perm = m.im_npage ? m.im_perm : 0;
+	}
+
+	return m.im_value;
+}
@@ -0,0 +1,104 @@
+/* The user library: syscall stubs, console output, IPC and fork().
+ *
+ * Programs built here are linked at UTEXT (user.lds), start in
+ * entry.S and go into the initrd; see the top Makefile. */
+
+#ifndef _USER_LIB_H_
+#define _USER_LIB_H_
+
+#include <types.h>
+#include <mmu.h>
+#include <error.h>
+#include <env.h>
+#include <unistd.h>
+#include <uinfo.h>
+#include <batch.h>
+#include <stdarg.h>
+
+// Where batch_init() maps the struct Batch of an env, just below UTEXT.
+#define BATCHVA		(UTEXT - BY2PG)
+
+/* libos.c */
+extern struct Batch *batch;
+
+void umain(void);
+void exit(void) __attribute__((noreturn));
+struct Batch *batch_init(void);
+int batch_flush(void);
+
+/* printf.c */
+void writef(char *fmt, ...);
+void _user_panic(const char *, int, const char *, ...)
+	__attribute__((noreturn));
+
+#define user_panic(...) _user_panic(__FILE__, __LINE__, __VA_ARGS__)
+
+/* syscall_lib.c */
+int msyscall(int sysno, int a1, int a2, int a3, int a4, int a5);
+
+// A message sys_ipc_recv() left in the receiver's registers.
+struct Ipc_msg {
+	u_int im_value;
+	u_int im_from;
+	u_int im_perm;
+	u_int im_npage;
+};
+
+void syscall_putchar(char ch);
+u_int syscall_getenvid(void);
+void syscall_yield(void);
+int syscall_env_destroy(u_int envid);
+int syscall_set_pgfault_handler(u_int envid, void (*func)(struct Uxframe *),
+								u_int xstacktop);
+int syscall_mem_alloc(u_int envid, u_int va, u_int perm);
+int syscall_mem_map(u_int srcid, u_int srcva, u_int dstid, u_int dstva,
+					u_int perm);
+int syscall_mem_unmap(u_int envid, u_int va);
+int syscall_set_env_status(u_int envid, u_int status);
+void syscall_panic(char *msg) __attribute__((noreturn));
+int syscall_ipc_can_send(u_int envid, u_int value, u_int srcva, u_int perm);
+int syscall_ipc_send(u_int envid, u_int value, u_int srcva, u_int perm);
+int syscall_ipc_recv(u_int dstva, u_int npage, struct Ipc_msg *m);
+int syscall_ipc_send_pages(u_int envid, u_int value, u_int srcva,
+						   u_int npage, u_int perm);
+int syscall_ring_create(u_int peerid, u_int va, u_int peerva);
+int syscall_ring_wait(u_int va);
+int syscall_ring_notify(u_int envid);
+int syscall_batch_setup(u_int va);
+int syscall_batch_enter(void);
+char syscall_cgetc(void);
+
+/* Overview:
+ *	Create a child with an empty address space, resuming from here
+ *	with 0 as the return value (see sys_env_alloc).
+ *
+ *	Inline so that the child returns straight into its caller's frame:
+ *	a frame of its own, below the caller's, could have been overwritten
+ *	by the parent by the time the child gets a copy of the stack.
+ */
+static inline int
+syscall_env_alloc(void)
+{
+	return msyscall(SYS_env_alloc, 0, 0, 0, 0, 0);
+}
+
+/* fork.c */
+// What fork() cost so far: syscalls run, and traps taken to run them.
+struct Fork_stat {
+	u_int forks;
+	u_int calls;
+	u_int traps;
+};
+
+extern struct Fork_stat fork_stat;
+
+int fork(void);
+
+/* pgfault.c */
+void set_pgfault_handler(void (*fn)(struct Uxframe *));
+
+/* ipc.c */
+void ipc_send(u_int whom, u_int val, u_int srcva, u_int perm);
+u_int ipc_recv(u_int *whom, u_int dstva, u_int *perm);
+
+#endif /* _USER_LIB_H_ */
@@ -0,0 +1,70 @@
+#include "lib.h"
+
+// This env's batch page (include/batch.h), once batch_init() maps it.
+struct Batch *batch;
+
+void
+exit(void)
+{
+	syscall_env_destroy(0);
+	for (;;)
+		;
+}
+
+void
+libmain(void)
+{
+	umain();
+	exit();
+}
+
+/* Overview:
+ *	Map this env's batch page at BATCHVA, unless it has one already.
+ *
+ * Post-Condition:
+ *	Return the page; a failure to map it is fatal.
+ */
+struct Batch *
+batch_init(void)
+{
+	int r;
+
+	if (batch == 0) {
+		if ((r = syscall_batch_setup(BATCHVA)) < 0) {
+			user_panic("batch_init: %d", r);
+		}
+		batch = (struct Batch *)BATCHVA;
+	}
+
+	return batch;
+}
+
+/* Overview:
+ *	Run the syscalls queued on `batch`, all in one trap.
+ *
+ * Post-Condition:
+ *	Return 0 if each of them succeeded, else the first error, theirs
+ *	or sys_batch_enter()'s.
+ */
+int
+batch_flush(void)
+{
+	u_int head = batch->b_head, tail = batch->b_tail;
+	int r;
+
+	if (head == tail) {
+		return 0;
+	}
+
+	if ((r = syscall_batch_enter()) < 0) {
+		return r;
+	}
+
+	for (; head != tail; head++) {
+		if ((r = batch->b_ent[head & (BATCH_NENT - 1)].be_ret) < 0) {
+			return r;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Mapping-heavy work with and without the batch page:
+ *
+ *	make initrd_progs=user/mapbench.b DEFS='-DPNAME=\"mapbench.b\"'
+ *
+ * Each round maps one page at NPAGE addresses with sys_mem_map() and
+ * unmaps them again with sys_mem_unmap(): 2 * NPAGE syscalls, made
+ * one trap each, or queued on the batch page and run BATCH_NENT to a
+ * sys_batch_enter().  Times are per round; the traps saved are the
+ * syscalls the batched rounds made less the traps they took.
+ */
+
+#include "bench.h"
+
+#define NROUND		64
+#define NPAGE		256
+#define SRC		0x10000000
+#define ARENA		0x20000000
+
+static u_int traps;
+
+static void
+queue(u_int sysno, u_int a1, u_int a2, u_int a3, u_int a4, u_int a5)
+{
+	int r;
+
+	while (batch_queue(batch, sysno, a1, a2, a3, a4, a5) == 0) {
+		if ((r = batch_flush()) < 0) {
+			user_panic("batch_flush: %d", r);
+		}
+		traps++;
+	}
+}
+
+void
+umain(void)
+{
+	u_int round, i, t, plain, batched;
+	int r;
+
+	batch_init();
+	*(volatile u_int *)SRC = 0;
+
+	t = bench_start();
+	for (round = 0; round < NROUND; round++) {
+		for (i = 0; i < NPAGE; i++) {
+			if ((r = syscall_mem_map(0, SRC, 0, ARENA + i * BY2PG,
+									 PTE_V | PTE_R)) < 0) {
+				user_panic("mem_map: %d", r);
+			}
+		}
+		for (i = 0; i < NPAGE; i++) {
+			syscall_mem_unmap(0, ARENA + i * BY2PG);
+		}
+	}
+	plain = uinfo_time_ms() - t;
+
+	t = bench_start();
+	for (round = 0; round < NROUND; round++) {
+		for (i = 0; i < NPAGE; i++) {
+			queue(SYS_mem_map, 0, SRC, 0, ARENA + i * BY2PG, PTE_V | PTE_R);
+		}
+		for (i = 0; i < NPAGE; i++) {
+			queue(SYS_mem_unmap, 0, ARENA + i * BY2PG, 0, 0, 0);
+		}
+		if ((r = batch_flush()) < 0) {
+			user_panic("batch_flush: %d", r);
+		}
+		traps++;
+	}
+	batched = uinfo_time_ms() - t;
+
+	writef("%d maps and unmaps: one trap each %d us\tbatched %d us, "
+		   "%d traps saved\n", NPAGE, plain * 1000 / NROUND,
+		   batched * 1000 / NROUND, (2 * NPAGE * NROUND - traps) / NROUND);
+	writef("mapbench: done\n");
+}
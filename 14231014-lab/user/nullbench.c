@@ -0,0 +1,49 @@
+/*
+ * The cost of a syscall that does nothing, on each way into the kernel:
+ *
+ *	make initrd_progs=user/nullbench.b DEFS='-DPNAME=\"nullbench.b\"'
+ *
+ * "fast" is sys_getenvid() on the fast path of handle_sys.  "full" is
+ * a syscall number past the table, which handle_sys sends down the
+ * slow path to fail there: a full SAVE_ALL/RESTORE_ALL trapframe and
+ * syscall_slow(), that is, what every syscall cost before the fast
+ * path.  "batched" is sys_getenvid() queued BATCH_NENT at a time on
+ * the batch page and run with one sys_batch_enter().
+ */
+
+#include "bench.h"
+
+#define NCALL		(64 * 1024)
+
+void
+umain(void)
+{
+	struct Batch *b = batch_init();
+	u_int i, j, t, fast, full, batched;
+
+	t = bench_start();
+	for (i = 0; i < NCALL; i++) {
+		syscall_getenvid();
+	}
+	fast = uinfo_time_ms() - t;
+
+	t = bench_start();
+	for (i = 0; i < NCALL; i++) {
+		msyscall(__SYSCALL_BASE + __NR_SYSCALLS, 0, 0, 0, 0, 0);
+	}
+	full = uinfo_time_ms() - t;
+
+	t = bench_start();
+	for (i = 0; i < NCALL; i += BATCH_NENT) {
+		for (j = 0; j < BATCH_NENT; j++) {
+			batch_queue(b, SYS_getenvid, 0, 0, 0, 0, 0);
+		}
+		syscall_batch_enter();
+	}
+	batched = uinfo_time_ms() - t;
+
+	writef("null syscall: fast %d ns\tfull %d ns\tbatched %d ns\n",
+		   bench_ns(fast, NCALL), bench_ns(full, NCALL),
+		   bench_ns(batched, NCALL));
+	writef("nullbench: done\n");
+}
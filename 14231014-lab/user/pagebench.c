@@ -0,0 +1,114 @@
+/*
+ * Bulk transfer from a parent to its child by page mapping:
+ *
+ *	make initrd_progs=user/pagebench.b DEFS='-DPNAME=\"pagebench.b\"'
+ *
+ * A 256K buffer goes over NROUND times:
+ *
+ *	single	one page per ipc_send(), as env_ipc_* allows
+ *	share	all 64 pages in one sys_ipc_send_pages()
+ *	move	the same with IPC_MOVE, so the sender's range is unmapped
+ *		and it demand-zeroes a fresh buffer for the next round
+ *
+ * Each side touches a word of every page it sends or gets, so nothing
+ * is copied: the rates are what mapping the buffer costs.
+ */
+
+#include "bench.h"
+
+#define NPAGE		IPC_MAXPAGE
+#define NROUND		32
+#define BUF		0x10000000
+#define WINDOW		0x30000000
+#define DONE		0xffffffff	/* value: reply, the run is over */
+
+static volatile u_int sink;
+
+static void
+receiver(void)
+{
+	struct Ipc_msg m;
+	u_int i;
+	int r;
+
+	for (;;) {
+		if ((r = syscall_ipc_recv(WINDOW, NPAGE, &m)) < 0) {
+			user_panic("ipc_recv: %d", r);
+		}
+		for (i = 0; i < m.im_npage; i++) {
+			sink = *(volatile u_int *)(WINDOW + i * BY2PG);
+		}
+		if (m.im_value == DONE) {
+			ipc_send(m.im_from, 0, 0, 0);
+		}
+	}
+}
+
+static void
+fill(void)
+{
+	u_int i;
+
+	for (i = 0; i < NPAGE; i++) {
+		*(volatile u_int *)(BUF + i * BY2PG) = i;
+	}
+}
+
+// Send the buffer NROUND times; return how long that took, in ms.
+static u_int
+run(u_int child, int single, u_int perm)
+{
+	u_int round, i, t;
+	int r;
+
+	t = bench_start();
+	for (round = 0; round < NROUND; round++) {
+		fill();
+		if (single) {
+			for (i = 0; i < NPAGE; i++) {
+				ipc_send(child, round, BUF + i * BY2PG, perm);
+			}
+			continue;
+		}
+		while ((r = syscall_ipc_send_pages(child, round, BUF, NPAGE,
+										   perm)) == -E_IPC_NOT_RECV) {
+			syscall_yield();
+		}
+		if (r < 0) {
+			user_panic("ipc_send_pages: %d", r);
+		}
+	}
+
+	ipc_send(child, DONE, 0, 0);
+	ipc_recv(0, 0, 0);
+	return uinfo_time_ms() - t;
+}
+
+// MB/s, in tenths, for NROUND buffers that took `ms`.
+static u_int
+rate(u_int ms)
+{
+	u_int kb = NROUND * NPAGE * (BY2PG / 1024);
+
+	return ms ? kb * 10000 / ms / 1024 : 0;
+}
+
+void
+umain(void)
+{
+	u_int child, single, share, move;
+
+	if ((child = fork()) == 0) {
+		receiver();
+	}
+
+	single = rate(run(child, 1, PTE_V | PTE_R));
+	share = rate(run(child, 0, PTE_V | PTE_R));
+	move = rate(run(child, 0, PTE_V | PTE_R | IPC_MOVE));
+
+	writef("single %d.%d MB/s\tshare %d.%d MB/s\tmove %d.%d MB/s\n",
+		   single / 10, single % 10, share / 10, share % 10,
+		   move / 10, move % 10);
+	syscall_env_destroy(child);
+	writef("pagebench: done\n");
+}
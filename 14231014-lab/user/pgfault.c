@@ -0,0 +1,22 @@
+#include "lib.h"
+#include <uvpt.h>
+
+/* Overview:
+ *	Make `fn` this env's page fault handler (see pgfault_upcall in
+ *	lib/traps.c), mapping its exception stack below UXSTACKTOP first if
+ *	there is none.  Failure is fatal.
+ */
+void
+set_pgfault_handler(void (*fn)(struct Uxframe *))
+{
+	int r;
+
+	if (!(uvpt_pte(UXSTACKTOP - BY2PG) & PTE_V) &&
+		(r = syscall_mem_alloc(0, UXSTACKTOP - BY2PG, PTE_V | PTE_R)) < 0) {
+		user_panic("set_pgfault_handler: %d", r);
+	}
+
+	if ((r = syscall_set_pgfault_handler(0, fn, UXSTACKTOP)) < 0) {
+		user_panic("set_pgfault_handler: %d", r);
+	}
+}
@@ -0,0 +1,83 @@
+/*
+ * IPC round trips between a parent and its child:
+ *
+ *	make initrd_progs=user/pingbench.b DEFS='-DPNAME=\"pingbench.b\"'
+ *
+ * The parent sends a value, the child sends it back plus one.  With
+ * "handoff" both sides send with sys_ipc_send(), which switches
+ * straight to the receiver; with "scheduled" they use
+ * sys_ipc_can_send(), which only makes the receiver runnable, and the
+ * sender's own sys_ipc_recv() leaves it to the scheduler to get there.
+ * Either way a sender that finds its peer not yet receiving yields
+ * and tries again, as ipc_send() does.  The values travel in
+ * registers (see ipc_deliver).
+ */
+
+#include "bench.h"
+
+#define NROUND		(4 * 1024)
+#define HANDOFF		0x80000000	/* in the value: reply with sys_ipc_send() */
+
+static void
+send(u_int whom, u_int val, int handoff)
+{
+	int r;
+
+	for (;;) {
+		r = handoff ? syscall_ipc_send(whom, val, 0, 0) :
+			syscall_ipc_can_send(whom, val, 0, 0);
+		if (r != -E_IPC_NOT_RECV) {
+			break;
+		}
+		syscall_yield();
+	}
+
+	if (r < 0) {
+		user_panic("send: %d", r);
+	}
+}
+
+static void
+echo(void)
+{
+	u_int v, from;
+
+	for (;;) {
+		v = ipc_recv(&from, 0, 0);
+		send(from, v + 1, v & HANDOFF);
+	}
+}
+
+// ns per round trip, in mode `handoff` (0 or HANDOFF)
+static u_int
+pingpong(u_int child, u_int handoff)
+{
+	u_int i, v, t;
+
+	t = bench_start();
+	for (i = 0; i < NROUND; i++) {
+		send(child, handoff | i, handoff);
+		if ((v = ipc_recv(0, 0, 0)) != (handoff | i) + 1) {
+			user_panic("pingpong: sent %x, got back %x", handoff | i, v);
+		}
+	}
+
+	return bench_ns(uinfo_time_ms() - t, NROUND);
+}
+
+void
+umain(void)
+{
+	u_int child, handoff, sched;
+
+	if ((child = fork()) == 0) {
+		echo();
+	}
+
+	handoff = pingpong(child, HANDOFF);
+	sched = pingpong(child, 0);
+
+	writef("round trip: handoff %d ns\tscheduled %d ns\n", handoff, sched);
+	syscall_env_destroy(child);
+	writef("pingbench: done\n");
+}
@@ -0,0 +1,41 @@
+#include "lib.h"
+#include <print.h>
+
+static void
+user_out(void *arg, char *s, int l)
+{
+	int i;
+
+	// special termination call
+	if ((l == 1) && (s[0] == '\0')) {
+		return;
+	}
+
+	for (i = 0; i < l; i++) {
+		syscall_putchar(s[i]);
+	}
+}
+
+void
+writef(char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	lp_Print(user_out, 0, fmt, ap);
+	va_end(ap);
+}
+
+void
+_user_panic(const char *file, int line, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	writef("panic at %s:%d: ", file, line);
+	lp_Print(user_out, 0, (char *)fmt, ap);
+	writef("\n");
+	va_end(ap);
+
+	exit();
+}
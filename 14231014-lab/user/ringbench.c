@@ -0,0 +1,104 @@
+/*
+ * Small-message throughput from a parent to its child, over a message
+ * ring (include/ring.h) and over env_ipc_*:
+ *
+ *	make initrd_progs=user/ringbench.b DEFS='-DPNAME=\"ringbench.b\"'
+ *
+ * The ring moves 16-byte messages, BATCH to a ring_put() or
+ * ring_get(); the producer yields when the ring is full, the consumer
+ * sleeps in sys_ring_wait() when it is empty, and sys_ring_notify()
+ * is made only when ring_put() asks for it.  IPC moves one word per
+ * message, with ipc_send() and ipc_recv().  Rates are messages per
+ * second until the child has taken the last one.
+ */
+
+#include "bench.h"
+#include <ring.h>
+
+#define NMSG_IPC	(4 * 1024)
+#define NMSG_RING	(64 * 1024)
+#define BATCH		16
+#define RINGVA		0x20000000
+
+static struct Ring *const tx = (struct Ring *)RINGVA + RING_TO_PEER;
+
+static void
+consumer(void)
+{
+	struct Ring_msg m[BATCH];
+	u_int n, i, parent;
+
+	for (n = 0; n < NMSG_IPC; n++) {
+		ipc_recv(&parent, 0, 0);
+	}
+	ipc_send(parent, n, 0, 0);
+
+	/* the parent says when the ring is there */
+	ipc_recv(0, 0, 0);
+
+	for (n = 0; n < NMSG_RING; n += i) {
+		if ((i = ring_get(tx, m, BATCH)) == 0) {
+			tx->r_waiting = 1;
+			if ((i = ring_get(tx, m, BATCH)) == 0) {
+				syscall_ring_wait((u_int)tx);
+			}
+			tx->r_waiting = 0;
+		}
+	}
+	ipc_send(parent, n, 0, 0);
+
+	for (;;) {
+		syscall_yield();
+	}
+}
+
+// Messages per second, for `n` that took `ms`.
+static u_int
+rate(u_int n, u_int ms)
+{
+	return ms ? n / ms * 1000 + n % ms * 1000 / ms : 0;
+}
+
+void
+umain(void)
+{
+	struct Ring_msg m[BATCH];
+	u_int child, n, i, t, ipc, ring;
+	int r, doorbell;
+
+	if ((child = fork()) == 0) {
+		consumer();
+	}
+
+	t = bench_start();
+	for (n = 0; n < NMSG_IPC; n++) {
+		ipc_send(child, n, 0, 0);
+	}
+	ipc_recv(0, 0, 0);
+	ipc = uinfo_time_ms() - t;
+
+	if ((r = syscall_ring_create(child, RINGVA, RINGVA)) < 0) {
+		user_panic("ring_create: %d", r);
+	}
+	ipc_send(child, 0, 0, 0);
+
+	t = bench_start();
+	for (n = 0; n < NMSG_RING; n += i) {
+		for (i = 0; i < BATCH; i++) {
+			m[i].rm_w[0] = n + i;
+		}
+		while ((i = ring_put(tx, m, BATCH, &doorbell)) == 0) {
+			syscall_yield();
+		}
+		if (doorbell) {
+			syscall_ring_notify(child);
+		}
+	}
+	ipc_recv(0, 0, 0);
+	ring = uinfo_time_ms() - t;
+
+	writef("ipc %d msg/s\tring %d msg/s\n",
+		   rate(NMSG_IPC, ipc), rate(NMSG_RING, ring));
+	syscall_env_destroy(child);
+	writef("ringbench: done\n");
+}
@@ -0,0 +1,125 @@
+#include "lib.h"
+
+/* One stub per syscall (lib/syscall_all.c has what each one does);
+ * syscall_env_alloc() is inline in lib.h and syscall_ipc_recv() is in
+ * syscall_wrap.S. */
+
+void
+syscall_putchar(char ch)
+{
+	msyscall(SYS_putchar, (int)ch, 0, 0, 0, 0);
+}
+
+u_int
+syscall_getenvid(void)
+{
+	return msyscall(SYS_getenvid, 0, 0, 0, 0, 0);
+}
+
+void
+syscall_yield(void)
+{
+	msyscall(SYS_yield, 0, 0, 0, 0, 0);
+}
+
+int
+syscall_env_destroy(u_int envid)
+{
+	return msyscall(SYS_env_destroy, envid, 0, 0, 0, 0);
+}
+
+int
+syscall_set_pgfault_handler(u_int envid, void (*func)(struct Uxframe *),
+							u_int xstacktop)
+{
+	return msyscall(SYS_set_pgfault_handler, envid, (int)func, xstacktop,
+					0, 0);
+}
+
+int
+syscall_mem_alloc(u_int envid, u_int va, u_int perm)
+{
+	return msyscall(SYS_mem_alloc, envid, va, perm, 0, 0);
+}
+
+int
+syscall_mem_map(u_int srcid, u_int srcva, u_int dstid, u_int dstva,
+				u_int perm)
+{
+	return msyscall(SYS_mem_map, srcid, srcva, dstid, dstva, perm);
+}
+
+int
+syscall_mem_unmap(u_int envid, u_int va)
+{
+	return msyscall(SYS_mem_unmap, envid, va, 0, 0, 0);
+}
+
+int
+syscall_set_env_status(u_int envid, u_int status)
+{
+	return msyscall(SYS_set_env_status, envid, status, 0, 0, 0);
+}
+
+void
+syscall_panic(char *msg)
+{
+	msyscall(SYS_panic, (int)msg, 0, 0, 0, 0);
+	for (;;)
+		;
+}
+
+int
+syscall_ipc_can_send(u_int envid, u_int value, u_int srcva, u_int perm)
+{
+	return msyscall(SYS_ipc_can_send, envid, value, srcva, perm, 0);
+}
+
+int
+syscall_ipc_send(u_int envid, u_int value, u_int srcva, u_int perm)
+{
+	return msyscall(SYS_ipc_send, envid, value, srcva, perm, 0);
+}
+
+int
+syscall_ipc_send_pages(u_int envid, u_int value, u_int srcva, u_int npage,
+					   u_int perm)
+{
+	return msyscall(SYS_ipc_send_pages, envid, value, srcva, npage, perm);
+}
+
+int
+syscall_ring_create(u_int peerid, u_int va, u_int peerva)
+{
+	return msyscall(SYS_ring_create, peerid, va, peerva, 0, 0);
+}
+
+int
+syscall_ring_wait(u_int va)
+{
+	return msyscall(SYS_ring_wait, va, 0, 0, 0, 0);
+}
+
+int
+syscall_ring_notify(u_int envid)
+{
+	return msyscall(SYS_ring_notify, envid, 0, 0, 0, 0);
+}
+
+int
+syscall_batch_setup(u_int va)
+{
+	return msyscall(SYS_batch_setup, va, 0, 0, 0, 0);
+}
+
+int
+syscall_batch_enter(void)
+{
+	return msyscall(SYS_batch_enter, 0, 0, 0, 0, 0);
+}
+
+char
+syscall_cgetc(void)
+{
+	return msyscall(SYS_cgetc, 0, 0, 0, 0, 0);
+}